@@ -1,22 +1,216 @@
 #include "api_handler.h"
 
+#include <boost/log/trivial.hpp>
+#include <boost/log/utility/manipulators/add_value.hpp>
+
+BOOST_LOG_ATTRIBUTE_KEYWORD(tick_data, "AdditionalData", boost::json::value);
+
 namespace http_handler {
 
-APIHandler::APIHandler(app::Application& app, net::io_context& ioc, bool no_auto_tick)
+namespace {
+
+void ReportTickError(const model::GameSession& session, std::string_view what) {
+    boost::json::value data{ {"map", *session.GetMap().GetId()}, {"exception", what}, {"where", "tick"} };
+    BOOST_LOG_TRIVIAL(error) << boost::log::add_value(tick_data, data) << "error";
+}
+
+// Пока сервер работает, сводка длительности тиков пишется в журнал с этим периодом
+constexpr auto TICK_REPORT_PERIOD = std::chrono::seconds{60};
+
+}  // namespace
+
+APIHandler::APIHandler(app::Application& app, net::io_context& ioc, bool no_auto_tick, const ResponseCompressor& compressor)
     : app_{ app },
     strand_(net::make_strand(ioc)),
-    auto_tick_(!no_auto_tick){
+    auto_tick_(!no_auto_tick),
+    compressor_(compressor),
+    map_cache_(app.GetMaps(), compressor),
+    response_cache_(app.GetSessions(), compressor),
+    broadcaster_(response_cache_, app.GetSessions()) {
+    for (const auto& session : app.GetSessions())
+        session_strands_.try_emplace(&session, net::make_strand(ioc));
+}
+
+void APIHandler::Tick(unsigned millisec, std::function<void()> done) {
+    using Clock = std::chrono::steady_clock;
+
+    struct TickState {
+        std::atomic<size_t> remaining;
+        Clock::time_point start;
+        std::function<void()> done;
+    };
+
+    auto& sessions = app_.GetSessions();
+    auto state = std::make_shared<TickState>(sessions.size(), Clock::now(), std::move(done));
+
+    const auto finish = [self = shared_from_this(), state] {
+        net::dispatch(self->strand_, [self, state] {
+            const auto now = Clock::now();
+            self->RecordTick(now - state->start, now);
+            if (state->done)
+                state->done();
+        });
+    };
+
+    if (sessions.empty())
+        return finish();
+
+    // Задачи тика выполняются в strand разных сессий параллельно, а отметки трассы
+    // не атомарны. Поэтому трасса запроса /tick в них не переносится
+    http_server::Tracer::Scope no_trace(nullptr);
+    for (auto& session : sessions) {
+        PostToSession(session, [self = shared_from_this(), &session, state, finish, millisec] {
+            try {
+                session.Tick(millisec);
+                self->broadcaster_.Broadcast(session);
+            } catch (const std::exception& e) {
+                // Ошибка в одной сессии не должна останавливать тики остальных
+                ReportTickError(session, e.what());
+            } catch (...) {
+                ReportTickError(session, "unknown exception"sv);
+            }
+            if (state->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                finish();
+        });
+    }
+}
+
+void APIHandler::RecordTick(app::TickStats::Duration elapsed, std::chrono::steady_clock::time_point now) {
+    app_.RecordTick(elapsed);
+    Metrics::RecordTick(elapsed);
+
+    tick_window_.Add(elapsed);
+    if (tick_window_start_ == std::chrono::steady_clock::time_point{})
+        tick_window_start_ = now;
+    if (now - tick_window_start_ < TICK_REPORT_PERIOD)
+        return;
+    BOOST_LOG_TRIVIAL(info) << boost::log::add_value(tick_data, utils::TickStatsToJson(tick_window_)) << "tick stats"sv;
+    tick_window_ = {};
+    tick_window_start_ = now;
+}
+
+void APIHandler::CollectMetrics(MetricsWriter& writer) const {
+    std::string labels;
+    const auto map_label = [&labels](const model::GameSession& session) -> std::string_view {
+        labels.clear();
+        MetricsWriter::AppendLabel(labels, "map"sv, *session.GetMap().GetId());
+        return labels;
+    };
+
+    writer.Family("game_session_dogs"sv, "gauge"sv, "Dogs in a game session"sv);
+    for (const auto& session : app_.GetSessions())
+        writer.Sample("game_session_dogs"sv, map_label(session), static_cast<uint64_t>(session.GetDogCount()));
+
+    writer.Family("game_session_strand_queue"sv, "gauge"sv, "Tasks waiting in the strand of a game session"sv);
+    for (const auto& [session, session_strand] : session_strands_) {
+        writer.Sample("game_session_strand_queue"sv, map_label(*session),
+                      static_cast<uint64_t>(session_strand.queued.load(std::memory_order_relaxed)));
+    }
+
+    const auto cache_stats = response_cache_.GetStats();
+    writer.Family("game_state_cache_hits_total"sv, "counter"sv, "Game state responses served from cache"sv);
+    writer.Sample("game_state_cache_hits_total"sv, {}, cache_stats.hits);
+    writer.Family("game_state_cache_misses_total"sv, "counter"sv, "Game state responses serialized on request"sv);
+    writer.Sample("game_state_cache_misses_total"sv, {}, cache_stats.misses);
+}
+
+void APIHandler::ParseJoinRequest(std::string_view body, ParsedRequest& parsed) const {
+    JsonArena arena;
+    // Значение создаётся в арене: присваивание результата разбора из другого ресурса памяти копировало бы его в кучу
+    json::value json_body(arena.GetStorage());
+    try {
+        json_body = json::parse(body, arena.GetStorage());
+    } catch (...) {
+        parsed.join_result = JoinParseResult::PARSE_ERROR;
+        return;
+    }
+
+    if (!json_body.is_object()) {
+        parsed.join_result = JoinParseResult::PARSE_ERROR;
+        return;
+    }
+
+    const auto& json_object = json_body.get_object();
+    const auto user_name = json_object.find("userName");
+    if (user_name == json_object.end() || !user_name->value().is_string()) {
+        parsed.join_result = JoinParseResult::PARSE_ERROR;
+        return;
+    }
+    if (user_name->value().get_string().empty()) {
+        parsed.join_result = JoinParseResult::INVALID_NAME;
+        return;
+    }
+
+    const auto map_id = json_object.find("mapId");
+    if (map_id == json_object.end() || !map_id->value().is_string()) {
+        parsed.join_result = JoinParseResult::PARSE_ERROR;
+        return;
+    }
+
+    parsed.join_session = app_.FindSession(model::Map::Id{map_id->value().get_string().c_str()});
+    if (parsed.join_session == nullptr) {
+        parsed.join_result = JoinParseResult::MAP_NOT_FOUND;
+        return;
+    }
+
+    parsed.user_name = user_name->value().get_string().c_str();
+    parsed.join_result = JoinParseResult::OK;
 }
 
-json::array APIHandler::ProcessMapsRequestBody() const {
-    auto maps_body = json::array();
-    for (const auto& map : app_.GetMaps()) {
-        json::object body;
-        body[std::string(model::ModelLiterals::ID)] = *map.GetId();
-        body[std::string(model::ModelLiterals::NAME)] = map.GetName();
-        maps_body.emplace_back(std::move(body));
+APIHandler::BatchParseResult APIHandler::ParseBatchActions(std::string_view body, std::vector<PlayerAction>& actions) const {
+    JsonArena arena;
+    json::value json_body(arena.GetStorage());
+    try {
+        json_body = json::parse(body, arena.GetStorage());
+    } catch (...) {
+        return BatchParseResult::PARSE_ERROR;
+    }
+
+    if (!json_body.is_array() || json_body.get_array().size() > MAX_BATCH_ACTIONS)
+        return BatchParseResult::PARSE_ERROR;
+
+    const auto& entries = json_body.get_array();
+    actions.reserve(entries.size());
+    for (const auto& entry : entries) {
+        if (!entry.is_object())
+            return BatchParseResult::PARSE_ERROR;
+
+        const auto& object = entry.get_object();
+        const auto token = object.find("token");
+        const auto move = object.find("move");
+        if (token == object.end() || !token->value().is_string() || move == object.end() || !move->value().is_string())
+            return BatchParseResult::PARSE_ERROR;
+
+        PlayerAction action{ nullptr, std::nullopt };
+        if (!ParseMove(move->value().get_string().c_str(), action.direction))
+            return BatchParseResult::PARSE_ERROR;
+
+        action.player = app_.FindByToken(app::Token(std::string{token->value().get_string().c_str()}));
+        if (action.player == nullptr)
+            return BatchParseResult::UNKNOWN_TOKEN;
+        if (!actions.empty() && action.player->GetSession() != actions.front().player->GetSession())
+            return BatchParseResult::SESSION_MISMATCH;
+
+        actions.push_back(action);
     }
-    return maps_body;
+    return BatchParseResult::OK;
+}
+
+bool APIHandler::ParseMove(std::string_view move, std::optional<model::Direction>& direction) {
+    if (move == "U"sv) direction = model::Direction::NORTH;
+    else if (move == "D"sv) direction = model::Direction::SOUTH;
+    else if (move == "L"sv) direction = model::Direction::WEST;
+    else if (move == "R"sv) direction = model::Direction::EAST;
+    else if (move.empty()) direction.reset();
+    else return false;
+    return true;
+}
+
+void APIHandler::ApplyAction(const PlayerAction& action) {
+    if (action.direction)
+        app_.Move(action.player, *action.direction);
+    else
+        app_.Stop(action.player);
 }
 
 bool APIHandler::ParseBearer(const std::string_view auth_header, std::string& token_to_write) const {
@@ -31,4 +225,29 @@ bool APIHandler::ParseBearer(const std::string_view auth_header, std::string& to
     return true;
 }
 
+bool APIHandler::ParseProtocolToken(std::string_view protocols, std::string& token_to_write) const {
+    bool has_protocol = false;
+    std::string_view token;
+    while (!protocols.empty()) {
+        const size_t comma = protocols.find(',');
+        std::string_view item = protocols.substr(0, comma);
+        protocols = comma == std::string_view::npos ? std::string_view{} : protocols.substr(comma + 1);
+
+        while (!item.empty() && item.front() == ' ')
+            item.remove_prefix(1);
+        while (!item.empty() && item.back() == ' ')
+            item.remove_suffix(1);
+
+        if (item == RestApiLiteral::WS_PROTOCOL)
+            has_protocol = true;
+        else if (item.starts_with(RestApiLiteral::WS_TOKEN_PREFIX))
+            token = item.substr(RestApiLiteral::WS_TOKEN_PREFIX.size());
+    }
+    // Ответ handshake подтверждает подпротокол game-state, поэтому без него клиент не примет соединение
+    if (!has_protocol || token.size() != 32)
+        return false;
+    token_to_write = token;
+    return true;
+}
+
 }
\ No newline at end of file
@@ -1,6 +1,11 @@
 #pragma once
 
+#include "binary_state.h"
 #include "http_response_factory.h"
+#include "json_writer.h"
+#include "metrics.h"
+#include "state_broadcaster.h"
+#include "tracer.h"
 
 namespace http_handler {
 
@@ -18,212 +23,398 @@ class APIHandler : public std::enable_shared_from_this<APIHandler> {
 public:
     using Strand = net::strand<net::io_context::executor_type>;
 
-    explicit APIHandler(app::Application& app, net::io_context& ioc, bool no_auto_tick);
+    enum class JoinParseResult {
+        OK,
+        PARSE_ERROR,
+        INVALID_NAME,
+        MAP_NOT_FOUND
+    };
+
+    // Запрос, разобранный в потоке соединения. Передаётся в strand вместе с запросом,
+    // чтобы не разбирать тело и не искать игрока повторно
+    struct ParsedRequest {
+        // PLAYERS, STATE, ACTION: заголовок Authorization корректен, player - найденный по токену игрок
+        bool valid_token = false;
+        app::Player* player = nullptr;
+        // JOIN
+        JoinParseResult join_result = JoinParseResult::PARSE_ERROR;
+        std::string user_name;
+        model::GameSession* join_session = nullptr;
+
+        // Сессия, в strand которой выполняется запрос, или nullptr, если запрос не дойдёт до игры
+        const model::GameSession* GetSession() const noexcept {
+            if (player)
+                return player->GetSession();
+            return join_result == JoinParseResult::OK ? join_session : nullptr;
+        }
+    };
+
+    APIHandler(app::Application& app, net::io_context& ioc, bool no_auto_tick, const ResponseCompressor& compressor);
 
     APIHandler(const APIHandler&) = delete;
     APIHandler& operator=(const APIHandler&) = delete;
 
+    // Точка входа для запросов API. Запросы, не изменяющие состояние игры, обрабатываются
+    // сразу в потоке соединения. Запросы авторизованного игрока и вход в игру выполняются
+    // в strand его игровой сессии, поэтому запросы к разным картам не ждут друг друга.
+    // route - маршрут, сопоставленный с целью запроса вызывающим кодом. Его строки нужны
+    // только до возврата из HandleRequest.
+    // after_pending - у соединения есть предыдущие запросы без готового ответа (HTTP pipelining):
+    // тогда чтение состояния тоже выполняется в strand, после них
+    template <typename Body, typename Allocator, typename Send>
+    void HandleRequest(
+        const RouteMatch& route,
+        http::request<Body, http::basic_fields<Allocator>>&& req,
+        Send&& send,
+        std::function<void(ResponseData&&)> handle,
+        bool after_pending = false
+    )
+    {
+        // Токен и тело входа в игру разбираются один раз, результат переносится в strand вместе с запросом
+        auto parsed = ParseRequest(route, req);
+
+        if (auto response = TryProcessConcurrently(route, req, parsed, send, after_pending))
+            return handle(std::move(*response));
+
+        if (route.route == ApiRoute::TICK)
+            return HandleTickRequest(route, req, std::forward<Send>(send), std::move(handle));
+
+        if (route.route == ApiRoute::ACTIONS)
+            return HandleBatchActionRequest(route, req, std::forward<Send>(send), std::move(handle));
+
+        const auto* session = parsed.GetSession();
+        if (session == nullptr) {
+            // Запрос не затрагивает состояние сессий: ответом будет ошибка разбора или авторизации
+            return handle(ProcessRequest(route, parsed, std::forward<Send>(send), std::move(req)));
+        }
+
+        // Строки маршрута в strand недействительны. Там из них нужна только строка запроса (since),
+        // её копия обычно помещается в буфер std::string без выделения памяти
+        DispatchToSession(*session, [self = shared_from_this(), route_ = route, query = std::string{route.query}, parsed = std::move(parsed)
+                                                  , req_ = std::move(req), send_ = std::forward<Send>(send), handle_ = std::move(handle)]() mutable {
+                route_.param = {};
+                route_.query = query;
+                handle_(self->ProcessRequest(route_, parsed, std::move(send_), std::move(req_)));
+            });
+    }
+
     template <typename Body, typename Allocator, typename Send>
 	ResponseData ProcessRequest(
-    	std::string_view target,
+    	const RouteMatch& route,
+    	const ParsedRequest& parsed,
     	Send&& send,
     	const http::request<Body, http::basic_fields<Allocator>>&& req
 	)
     {
-    	const auto path_segments = utils::SplitRequest(target.substr(1));
-    	const std::string_view http_method = req.method_string();
-    	const auto http_version = req.version();
+    	if (route.route == ApiRoute::NOT_FOUND)
+        	return HttpResponseFactory::HandleBadRequest(std::forward<Send>(send));
+
+    	if (!route.method_allowed) {
+        	return HttpResponseFactory::HandleMethodNotAllowed(
+            	std::forward<Send>(send),
+            	route.allow
+        	);
+    	}
 
-    	if (path_segments.size() < 3)
+    	switch (route.route) {
+    	case ApiRoute::JOIN:
+        	return HandleJoinRequest(parsed, std::forward<Send>(send));
+    	case ApiRoute::PLAYERS:
+    	case ApiRoute::STATE:
+    	case ApiRoute::ACTION:
+        	break;
+    	default:
+        	// Карты и тик обрабатываются в HandleRequest
         	return HttpResponseFactory::HandleBadRequest(std::forward<Send>(send));
+    	}
 
-    	const auto& resource = path_segments[2];
-
-    	if (resource == RestApiLiteral::MAPS) {
-        	if (path_segments.size() == 4) {
-            	return HandleMapRequest(
-                	std::string(path_segments[3]),
-                	std::forward<Send>(send)
-            	);
-        	}
-        	if (path_segments.size() == 3) {
-            	const auto response_body = json::serialize(ProcessMapsRequestBody());
-            	HttpResponseFactory::HandleAPIResponse(
-                	http::status::ok,
-                	response_body,
-                	std::forward<Send>(send)
-            	);
-            	return {http::status::ok, MimeType::APP_JSON};
-        	}
+    	if (!parsed.valid_token) {
+        	HttpResponseFactory::HandleAPIResponse(
+            	http::status::unauthorized,
+            	RequestHttpBody::INVALID_TOKEN,
+            	std::forward<Send>(send)
+        	);
+        	return {http::status::unauthorized, MimeType::APP_JSON};
     	}
 
-    	if (resource == RestApiLiteral::MAP) {
-        	if (path_segments.size() != 4)
-            	return HttpResponseFactory::HandleBadRequest(std::forward<Send>(send));
+    	const auto encoding = compressor_.Negotiate(req.base()[http::field::accept_encoding]);
 
-        	return HandleMapRequest(
-            	std::string(path_segments[3]),
-           	 	std::forward<Send>(send)
+    	if (route.route == ApiRoute::PLAYERS)
+        	return HandlePlayersRequest(parsed.player, encoding, std::forward<Send>(send));
+
+    	if (route.route == ApiRoute::STATE) {
+        	return HandleStateRequest(
+            	parsed.player,
+            	utils::GetQueryParam(route.query, RestApiLiteral::SINCE),
+            	utils::AcceptsMimeType(req.base()[http::field::accept], MimeType::GAME_STATE),
+            	encoding,
+            	std::forward<Send>(send)
         	);
     	}
 
-    	if (resource == RestApiLiteral::GAME) {
-        	if (path_segments.size() < 4)
-            	return HttpResponseFactory::HandleBadRequest(std::forward<Send>(send));
-
-        	const auto& action = path_segments[3];
-
-        	if (action == RestApiLiteral::JOIN) {
-            	if (http_method != "POST") {
-                	return HttpResponseFactory::HandleMethodNotAllowed(
-                    	std::forward<Send>(send),
-                    	"POST"
-                	);
-            	}
-            	return HandleJoinRequest(req.body(), std::forward<Send>(send));
-        	}
-
-        	if (action == RestApiLiteral::PLAYERS) {
-            	if (http_method != "GET" && http_method != "HEAD") {
-                	return HttpResponseFactory::HandleMethodNotAllowed(
-                    	std::forward<Send>(send),
-                    	"GET, HEAD"
-                	);
-            	}
-
-            	std::string auth_token;
-            	const bool valid_token = ParseBearer(
-                	req.base()[http::field::authorization],
-                	auth_token
-            	);
-
-            	if (!valid_token) {
-                	HttpResponseFactory::HandleAPIResponse(
-                    	http::status::unauthorized,
-                    	RequestHttpBody::INVALID_TOKEN,
-                    	std::forward<Send>(send)
-                	);
-                	return {http::status::unauthorized, MimeType::APP_JSON};
-            	}
-
-            	return HandlePlayersRequest(std::move(auth_token), std::forward<Send>(send));
-        	}
-
-        	if (action == RestApiLiteral::STATE) {
-            	if (http_method != "GET" && http_method != "HEAD") {
-                	return HttpResponseFactory::HandleMethodNotAllowed(
-                    	std::forward<Send>(send),
-                    	"GET, HEAD"
-                	);
-            	}
-
-            	std::string auth_token;
-            	const bool valid_token = ParseBearer(
-                	req.base()[http::field::authorization],
-                	auth_token
-            	);
-
-            	if (!valid_token) {
-                	HttpResponseFactory::HandleAPIResponse(
-                    	http::status::unauthorized,
-                    	RequestHttpBody::INVALID_TOKEN,
-                    	std::forward<Send>(send)
-                	);
-                	return {http::status::unauthorized, MimeType::APP_JSON};
-            	}
-
-            	return HandleStateRequest(std::move(auth_token), std::forward<Send>(send));
-        	}
-
-        	if (action == RestApiLiteral::PLAYER) {
-            	if (path_segments.size() == 4) {
-                	HttpResponseFactory::HandleAPIResponse(
-                    	http::status::bad_request,
-                    	RequestHttpBody::BAD_REQUEST,
-                    	std::forward<Send>(send)
-                	);
-                	return {http::status::bad_request, MimeType::APP_JSON};
-            	}
-
-            	if (path_segments[4] == RestApiLiteral::ACTION) {
-                	if (http_method != "POST") {
-                    	return HttpResponseFactory::HandleMethodNotAllowed(
-                        	std::forward<Send>(send),
-                        	"POST"
-                    	);
-                	}
-
-                	std::string auth_token;
-                	const bool valid_token = ParseBearer(
-                    	req.base()[http::field::authorization],
-                    	auth_token
-                	);
-
-                	if (!valid_token) {
-                    	HttpResponseFactory::HandleAPIResponse(
-                        	http::status::unauthorized,
-                        	RequestHttpBody::INVALID_TOKEN,
-                        	std::forward<Send>(send)
-                    	);
-                    	return {http::status::unauthorized, MimeType::APP_JSON};
-                	}
-
-                	if (req.base()[http::field::content_type] != MimeType::APP_JSON) {
-                    	HttpResponseFactory::HandleAPIResponse(
-                        	http::status::bad_request,
-                        	RequestHttpBody::INVALID_CONTENT_TYPE,
-                        	std::forward<Send>(send)
-                    	);
-                    	return {http::status::bad_request, MimeType::APP_JSON};
-                	}
-
-                	return HandleActionRequest(
-                    	std::move(auth_token),
-                    	req.body(),
-                    	std::forward<Send>(send)
-                	);
-            	}
-        	}
-
-        	if (action == RestApiLiteral::TICK) {
-            	if (auto_tick_)
-                	return HttpResponseFactory::HandleBadRequest(std::forward<Send>(send));
-
-            	if (http_method != "POST") {
-                	return HttpResponseFactory::HandleMethodNotAllowed(
-                    	std::forward<Send>(send),
-                    	"POST"
-                	);
-            	}
-
-            	return HandleTickRequest(req.body(), std::forward<Send>(send));
-        	}
+    	if (req.base()[http::field::content_type] != MimeType::APP_JSON) {
+        	HttpResponseFactory::HandleAPIResponse(
+            	http::status::bad_request,
+            	RequestHttpBody::INVALID_CONTENT_TYPE,
+            	std::forward<Send>(send)
+        	);
+        	return {http::status::bad_request, MimeType::APP_JSON};
     	}
 
-    	return HttpResponseFactory::HandleBadRequest(std::forward<Send>(send));
+    	return HandleActionRequest(
+        	parsed.player,
+        	req.body(),
+        	std::forward<Send>(send)
+    	);
 	}
 
+    // Подписка на состояние сессии через WebSocket: GET /api/v1/game/state с заголовком Upgrade.
+    // Токен передаётся в заголовке Authorization или в Sec-WebSocket-Protocol вместе с подпротоколом
+    // game-state, но не в строке запроса: она попадает в журналы. Подписка выполняется в strand сессии игрока
+    template <typename Body, typename Allocator>
+    void HandleUpgrade(
+        http::request<Body, http::basic_fields<Allocator>>&& req,
+        std::shared_ptr<http_server::WebSocketSession> ws,
+        std::function<void(ResponseData&&)> handle
+    )
+    {
+        std::string decoded_target;
+        const auto route = ApiRouter::Match(DecodeTarget(req.target(), decoded_target), req.method());
+
+        if (route.route != ApiRoute::STATE) {
+            ws->Reject(http::status::bad_request, RequestHttpBody::BAD_REQUEST, MimeType::APP_JSON);
+            return handle({ http::status::bad_request, MimeType::APP_JSON });
+        }
+
+        std::string auth_token;
+        std::string_view protocol;
+        bool valid_token = ParseBearer(req.base()[http::field::authorization], auth_token);
+        if (!valid_token && ParseProtocolToken(req.base()[http::field::sec_websocket_protocol], auth_token)) {
+            valid_token = true;
+            protocol = RestApiLiteral::WS_PROTOCOL;
+        }
+
+        if (!valid_token) {
+            ws->Reject(http::status::unauthorized, RequestHttpBody::INVALID_TOKEN, MimeType::APP_JSON);
+            return handle({ http::status::unauthorized, MimeType::APP_JSON });
+        }
+
+        const auto* player = app_.FindByToken(app::Token(std::move(auth_token)));
+        if (player == nullptr) {
+            ws->Reject(http::status::unauthorized, RequestHttpBody::TOKEN_UNKNOWN, MimeType::APP_JSON);
+            return handle({ http::status::unauthorized, MimeType::APP_JSON });
+        }
+
+        const auto* session = player->GetSession();
+        DispatchToSession(*session, [self = shared_from_this(), session, protocol, req_ = std::move(req), ws_ = std::move(ws)
+                                                  , handle_ = std::move(handle)]() mutable {
+                self->broadcaster_.Subscribe(session, ws_);
+                ws_->Accept(std::move(req_), self->broadcaster_.MakeFrame(*session), protocol);
+                handle_({ http::status::switching_protocols, MimeType::APP_JSON });
+            });
+    }
+
+    // Выполняет тик во всех сессиях: каждая обновляется в своём strand и сразу рассылает
+    // новое состояние подписчикам. done вызывается в strand тиков, когда обновлены все сессии
+    void Tick(unsigned millisec, std::function<void()> done);
+
+    // strand тиков: в нём завершаются тики и учитывается их статистика
     Strand& GetStrand() { return strand_; }
+    SessionResponseCache::Stats GetResponseCacheStats() const { return response_cache_.GetStats(); }
+    // Собаки и очередь strand по сессиям, статистика кеша состояния
+    void CollectMetrics(MetricsWriter& writer) const;
 private:
+    // strand сессии со счётчиком поставленных в него и ещё не начатых задач
+    struct SessionStrand {
+        explicit SessionStrand(Strand s)
+            : strand(std::move(s)) {
+        }
+
+        // Трасса запроса переносится в strand вместе с задачей
+        template <typename F>
+        auto Enqueue(F&& f) {
+            queued.fetch_add(1, std::memory_order_relaxed);
+            auto trace = http_server::Tracer::Current();
+            if (trace)
+                trace->Mark(http_server::TraceStage::QUEUED);
+            return [&queued = queued, trace = std::move(trace), f = std::forward<F>(f)]() mutable {
+                queued.fetch_sub(1, std::memory_order_relaxed);
+                if (trace)
+                    trace->Mark(http_server::TraceStage::HANDLER);
+                http_server::Tracer::Scope scope(std::move(trace));
+                f();
+            };
+        }
+
+        Strand strand;
+        std::atomic<size_t> queued{0};
+    };
+
     app::Application& app_;
     Strand strand_;
+    // Набор сессий задаётся при запуске, после этого таблица только читается
+    std::unordered_map<const model::GameSession*, SessionStrand> session_strands_;
     bool auto_tick_;
+    const ResponseCompressor& compressor_;
+    const MapResponseCache map_cache_;
+    SessionResponseCache response_cache_;
+    StateBroadcaster broadcaster_;
+    // Тики с начала текущего периода отчёта. Доступны только из strand_
+    app::TickStats tick_window_;
+    std::chrono::steady_clock::time_point tick_window_start_;
+
+    // Учитывает завершённый тик в статистике приложения, метриках и периодическом отчёте
+    void RecordTick(app::TickStats::Duration elapsed, std::chrono::steady_clock::time_point now);
+
+    // Выполняет f в strand сессии. Число задач, ожидающих в strand, видно в метриках
+    template <typename F>
+    void DispatchToSession(const model::GameSession& session, F&& f) {
+        auto& session_strand = session_strands_.at(&session);
+        net::dispatch(session_strand.strand, session_strand.Enqueue(std::forward<F>(f)));
+    }
 
-    json::array ProcessMapsRequestBody() const;
+    template <typename F>
+    void PostToSession(const model::GameSession& session, F&& f) {
+        auto& session_strand = session_strands_.at(&session);
+        net::post(session_strand.strand, session_strand.Enqueue(std::forward<F>(f)));
+    }
 
-    template<typename Send>
-	ResponseData HandleMapRequest(std::string id, Send&& send) {
-    	model::Map::Id map_id(std::move(id));
-    	const auto* map = app_.FindMap(map_id);
+    // Разбирает токен запросов игрока и тело запроса на вход в игру
+    template <typename Body, typename Allocator>
+    ParsedRequest ParseRequest(
+        const RouteMatch& route,
+        const http::request<Body, http::basic_fields<Allocator>>& req
+    ) const
+    {
+        ParsedRequest parsed;
+        if (!route.method_allowed)
+            return parsed;
+
+        switch (route.route) {
+        case ApiRoute::JOIN:
+            ParseJoinRequest(req.body(), parsed);
+            return parsed;
+        case ApiRoute::PLAYERS:
+        case ApiRoute::STATE:
+        case ApiRoute::ACTION:
+            break;
+        default:
+            return parsed;
+        }
 
-    	if (map != nullptr) {
-        	const auto response_body = json::serialize(utils::MapToJson(map));
+        std::string auth_token;
+        parsed.valid_token = ParseBearer(req.base()[http::field::authorization], auth_token);
+        if (parsed.valid_token)
+            parsed.player = app_.FindByToken(app::Token(std::move(auth_token)));
+        return parsed;
+    }
+
+    void ParseJoinRequest(std::string_view body, ParsedRequest& parsed) const;
+
+    // Обрабатывает без strand запросы карт, ошибки авторизации и запросы /players и /state,
+    // ответ на которые уже есть в кеше. Реестр игроков и кеш ответов допускают чтение
+    // из любого потока. Возвращает nullopt, если запрос должен выполниться в strand
+    template <typename Body, typename Allocator, typename Send>
+    std::optional<ResponseData> TryProcessConcurrently(
+        const RouteMatch& route,
+        const http::request<Body, http::basic_fields<Allocator>>& req,
+        const ParsedRequest& parsed,
+        Send& send,
+        bool after_pending
+    ) const
+    {
+    	const std::string_view if_none_match = req.base()[http::field::if_none_match];
+    	const bool is_head_method = req.method() == http::verb::head;
+    	const auto encoding = compressor_.Negotiate(req.base()[http::field::accept_encoding]);
+
+    	switch (route.route) {
+    	case ApiRoute::MAP_LIST:
+        	return HttpResponseFactory::HandleCachedResponse(
+            	map_cache_.GetMapList(),
+            	if_none_match,
+            	std::move(send),
+            	is_head_method,
+            	encoding
+        	);
+    	case ApiRoute::MAP:
+        	return HandleMapRequest(
+            	route.param,
+            	if_none_match,
+            	std::move(send),
+            	is_head_method,
+            	encoding
+        	);
+    	case ApiRoute::PLAYERS:
+    	case ApiRoute::STATE:
+        	if (route.method_allowed)
+            	break;
+        	return std::nullopt;
+    	default:
+        	return std::nullopt;
+    	}
+
+    	if (!parsed.valid_token) {
         	HttpResponseFactory::HandleAPIResponse(
-            	http::status::ok,
-            	response_body,
-            	std::forward<Send>(send)
+            	http::status::unauthorized,
+            	RequestHttpBody::INVALID_TOKEN,
+            	std::move(send)
+        	);
+        	return ResponseData{ http::status::unauthorized, MimeType::APP_JSON };
+    	}
+
+    	const auto* player = parsed.player;
+    	if (player == nullptr) {
+        	HttpResponseFactory::HandleAPIResponse(
+            	http::status::unauthorized,
+            	RequestHttpBody::TOKEN_UNKNOWN,
+            	std::move(send)
+        	);
+        	return ResponseData{ http::status::unauthorized, MimeType::APP_JSON };
+    	}
+
+    	// Предыдущий запрос соединения может ещё ждать в strand сессии, например действие игрока.
+    	// Ответ из кеша обогнал бы его, поэтому запрос ставится в тот же strand следом
+    	if (after_pending)
+        	return std::nullopt;
+
+    	const bool binary = utils::AcceptsMimeType(req.base()[http::field::accept], MimeType::GAME_STATE);
+
+    	std::optional<SessionResponseCache::EncodedBody> body;
+    	if (route.route == ApiRoute::PLAYERS)
+        	body = response_cache_.TryGetPlayers(*player->GetSession(), encoding);
+    	else if (utils::GetQueryParam(route.query, RestApiLiteral::SINCE))
+        	return std::nullopt;
+    	else if (binary)
+        	body = response_cache_.TryGetBinaryState(*player->GetSession());
+    	else
+        	body = response_cache_.TryGetState(*player->GetSession(), encoding);
+
+    	if (!body)
+        	return std::nullopt;
+
+    	const auto type = route.route == ApiRoute::STATE && binary ? MimeType::GAME_STATE : MimeType::APP_JSON;
+    	return HandleEncodedResponse(std::move(*body), std::move(send), type);
+    }
+
+    // Тело из кеша сессии, заранее сжатое выбранным кодированием
+    template<typename Send>
+    static ResponseData HandleEncodedResponse(SessionResponseCache::EncodedBody&& body, Send&& send,
+                                              std::string_view type = MimeType::APP_JSON) {
+    	return HttpResponseFactory::HandleSharedResponse(http::status::ok, std::move(body.body), std::forward<Send>(send), type,
+                                                     false, body.encoding, body.raw_size);
+    }
+
+    template<typename Send>
+	ResponseData HandleMapRequest(std::string_view id, std::string_view if_none_match, Send&& send, bool is_head_method,
+	                              ContentEncoding encoding) const {
+    	if (const auto* cached = map_cache_.FindMap(id); cached != nullptr) {
+        	return HttpResponseFactory::HandleCachedResponse(
+            	*cached,
+            	if_none_match,
+            	std::forward<Send>(send),
+            	is_head_method,
+            	encoding
         	);
-        	return { http::status::ok, MimeType::APP_JSON };
     	}
 
     	HttpResponseFactory::HandleAPIResponse(
@@ -235,43 +426,25 @@ private:
 	}
 
     template<typename Send>
-    ResponseData HandleJoinRequest(std::string_view body, Send&& send) {
-        json::object json_body;
-        try {
-            json_body = json::parse(body.data()).as_object();
-        } catch (...) {
-            HttpResponseFactory::HandleAPIResponse(
-                http::status::bad_request,
-                RequestHttpBody::JOIN_GAME_PARSE_ERROR,
-                std::move(send)
-            );
-            return {http::status::bad_request, MimeType::APP_JSON};
-        }
-
-        const auto validate_field = [&json_body](boost::json::string_view field) {
-            return !json_body.contains(field) || !json_body.at(field).is_string();
-        };
-
-        if (validate_field("userName")) {
+    ResponseData HandleJoinRequest(const ParsedRequest& parsed, Send&& send) {
+        switch (parsed.join_result) {
+        case JoinParseResult::OK:
+            break;
+        case JoinParseResult::INVALID_NAME:
             HttpResponseFactory::HandleAPIResponse(
                 http::status::bad_request,
-                RequestHttpBody::JOIN_GAME_PARSE_ERROR,
+                RequestHttpBody::INVALID_NAME,
                 std::move(send)
             );
             return {http::status::bad_request, MimeType::APP_JSON};
-        }
-
-        const auto user_name = json_body.at("userName").get_string();
-        if (user_name.empty()) {
+        case JoinParseResult::MAP_NOT_FOUND:
             HttpResponseFactory::HandleAPIResponse(
-                http::status::bad_request,
-                RequestHttpBody::INVALID_NAME,
+                http::status::not_found,
+                RequestHttpBody::MAP_NOT_FOUND,
                 std::move(send)
             );
-            return {http::status::bad_request, MimeType::APP_JSON};
-        }
-
-        if (validate_field("mapId")) {
+            return {http::status::not_found, MimeType::APP_JSON};
+        default:
             HttpResponseFactory::HandleAPIResponse(
                 http::status::bad_request,
                 RequestHttpBody::JOIN_GAME_PARSE_ERROR,
@@ -280,23 +453,11 @@ private:
             return {http::status::bad_request, MimeType::APP_JSON};
         }
 
-        const auto map_id = json_body.at("mapId").get_string();
-        const model::Map::Id id{map_id.data()};
-        auto* session = app_.FindSession(id);
-
-        if (!session) {
-            HttpResponseFactory::HandleAPIResponse(
-                http::status::not_found,
-                RequestHttpBody::MAP_NOT_FOUND,
-                std::move(send)
-            );
-            return {http::status::not_found, MimeType::APP_JSON};
-        }
-
-        model::Dog dog{std::string{user_name.data()}};
-        auto& player = app_.AddPlayer(std::move(dog), session);
+        model::Dog dog{std::string{parsed.user_name}};
+        auto& player = app_.AddPlayer(std::move(dog), parsed.join_session);
 
-        json::object result;
+        JsonArena arena;
+        json::object result(arena.GetStorage());
         app::Token token = player.GetToken();
         result["authToken"] = std::string{*token};
         result["playerId"] = player.GetId();
@@ -310,10 +471,7 @@ private:
     }
 
 	template<typename Send>
-	ResponseData HandlePlayersRequest(std::string&& token, Send&& send) {
-    	app::Token player_token(std::move(token));
-    	auto* player = app_.FindByToken(player_token);
-
+	ResponseData HandlePlayersRequest(const app::Player* player, ContentEncoding encoding, Send&& send) {
     	if (player == nullptr) {
         	HttpResponseFactory::HandleAPIResponse(
             	http::status::unauthorized,
@@ -323,25 +481,19 @@ private:
         	return { http::status::unauthorized, MimeType::APP_JSON };
     	}
 
-    	json::object result;
-
-    	for (const auto* dog : app_.GetDogs(player))
-        	result[std::to_string(dog->GetId())] = json::array{ "name", dog->GetName() };
-
-    	HttpResponseFactory::HandleAPIResponse(
-        	http::status::ok,
-        	json::serialize(result),
+    	return HandleEncodedResponse(
+        	response_cache_.GetPlayers(*player->GetSession(), encoding),
         	std::forward<Send>(send)
     	);
-
-    	return { http::status::ok, MimeType::APP_JSON };
 	}
 
+    // Без параметра since возвращает полное состояние сессии.
+    // С параметром since - только собак, изменившихся начиная с тика since,
+    // номер текущего тика и идентификаторы удалённых собак.
+    // binary - клиент принимает состояние в формате binary_state, encoding - выбранное сжатие JSON
     template<typename Send>
-	ResponseData HandleStateRequest(std::string&& token, Send&& send) {
-    	app::Token player_token(std::move(token));
-    	const auto* player = app_.FindByToken(player_token);
-
+	ResponseData HandleStateRequest(const app::Player* player, std::optional<std::string_view> since, bool binary,
+	                                ContentEncoding encoding, Send&& send) {
     	if (player == nullptr) {
         	HttpResponseFactory::HandleAPIResponse(
             	http::status::unauthorized,
@@ -351,34 +503,54 @@ private:
         	return { http::status::unauthorized, MimeType::APP_JSON };
     	}
 
-    	json::object result;
-    	json::object players;
+    	if (!since && binary) {
+        	return HandleEncodedResponse(
+            	response_cache_.GetBinaryState(*player->GetSession()),
+            	std::forward<Send>(send),
+            	MimeType::GAME_STATE
+        	);
+    	}
 
-    	const auto& dogs = app_.GetDogs(player);
+    	if (!since) {
+        	return HandleEncodedResponse(
+            	response_cache_.GetState(*player->GetSession(), encoding),
+            	std::forward<Send>(send)
+        	);
+    	}
 
-    	for (const auto* dog : dogs) {
-        	json::object dog_data;
+    	uint64_t since_tick = 0;
+    	const auto [end, ec] = std::from_chars(since->data(), since->data() + since->size(), since_tick);
+    	if (ec != std::errc{} || end != since->data() + since->size()) {
+        	HttpResponseFactory::HandleAPIResponse(
+            	http::status::bad_request,
+            	RequestHttpBody::INVALID_SINCE,
+            	std::forward<Send>(send)
+        	);
+        	return { http::status::bad_request, MimeType::APP_JSON };
+    	}
 
-        	const auto pos = dog->GetPosition();
-        	dog_data["pos"] = json::array{ pos.x, pos.y };
+    	const auto* session = player->GetSession();
 
-        	const auto speed = dog->GetSpeed();
-        	dog_data["speed"] = json::array{ speed.vx, speed.vy };
+    	// Буфер потока переиспользуется между запросами и не перевыделяется при записи
+    	thread_local std::string body;
+    	body.clear();
 
-        	switch (dog->GetDirection()) {
-            	case model::Direction::NORTH: dog_data["dir"] = "U"; break;
-            	case model::Direction::SOUTH: dog_data["dir"] = "D"; break;
-                case model::Direction::EAST:  dog_data["dir"] = "R"; break;
-				case model::Direction::WEST:  dog_data["dir"] = "L"; break;
-        	}
-        	players[std::to_string(dog->GetId())] = std::move(dog_data);
+    	if (binary) {
+        	binary_state::WriteState(body, session->GetDogsChangedSince(since_tick), session->GetTickNumber());
+        	HttpResponseFactory::HandleResponse(
+            	http::status::ok,
+            	body,
+            	std::forward<Send>(send),
+            	MimeType::GAME_STATE
+        	);
+        	return { http::status::ok, MimeType::GAME_STATE };
     	}
 
-    	result["players"] = std::move(players);
+    	json_writer::WriteStateDelta(body, session->GetDogsChangedSince(since_tick), session->GetTickNumber());
 
     	HttpResponseFactory::HandleAPIResponse(
         	http::status::ok,
-        	json::serialize(result),
+        	body,
         	std::forward<Send>(send)
     	);
 
@@ -387,8 +559,7 @@ private:
 
 
 	template<typename Send>
-	ResponseData HandleActionRequest(std::string&& token, std::string_view body, Send&& send) {
-    	auto* player = app_.FindByToken(app::Token(std::move(token)));
+	ResponseData HandleActionRequest(app::Player* player, std::string_view body, Send&& send) {
     	if (!player) {
         	HttpResponseFactory::HandleAPIResponse(
             	http::status::unauthorized,
@@ -398,10 +569,17 @@ private:
         	return {http::status::unauthorized, MimeType::APP_JSON};
     	}
 
-    	json::object json_body;
+    	JsonArena arena;
+    	json::value json_body(arena.GetStorage());
     	try {
-        	json_body = json::parse(body.data()).as_object();
+        	json_body = json::parse(body, arena.GetStorage());
     	} catch (...) {
+        	// Ошибка разбора обрабатывается ниже: json_body остаётся null
+    	}
+
+    	// Объект берётся по ссылке: as_object() с присваиванием скопировал бы его
+    	const auto* json_object = json_body.if_object();
+    	if (json_object == nullptr) {
         	HttpResponseFactory::HandleAPIResponse(
             	http::status::bad_request,
             	RequestHttpBody::ACTION_PARSE_ERROR,
@@ -410,8 +588,8 @@ private:
         	return {http::status::bad_request, MimeType::APP_JSON};
     	}
 
-    	const auto move_it = json_body.find("move");
-    	if (move_it == json_body.end() || !move_it->value().is_string()) {
+    	const auto move_it = json_object->find("move");
+    	if (move_it == json_object->end() || !move_it->value().is_string()) {
         	HttpResponseFactory::HandleAPIResponse(
             	http::status::bad_request,
             	RequestHttpBody::ACTION_PARSE_ERROR,
@@ -420,14 +598,8 @@ private:
         	return {http::status::bad_request, MimeType::APP_JSON};
     	}
 
-    	const std::string_view move_value = move_it->value().get_string().c_str();
-
-    	if (move_value == "U") { app_.Move(player, model::Direction::NORTH); }
-        else if (move_value == "D") { app_.Move(player, model::Direction::SOUTH); }
-        else if (move_value == "L") { app_.Move(player, model::Direction::WEST); }
-        else if (move_value == "R") { app_.Move(player, model::Direction::EAST); }
-        else if (move_value.empty()) { app_.Stop(player); }
-        else {
+    	PlayerAction action{ player, std::nullopt };
+    	if (!ParseMove(move_it->value().get_string().c_str(), action.direction)) {
         	HttpResponseFactory::HandleAPIResponse(
             	http::status::bad_request,
             	RequestHttpBody::ACTION_PARSE_ERROR,
@@ -435,6 +607,7 @@ private:
         	);
         	return {http::status::bad_request, MimeType::APP_JSON};
     	}
+    	ApplyAction(action);
 
     	HttpResponseFactory::HandleAPIResponse(
         	http::status::ok,
@@ -444,55 +617,131 @@ private:
     	return {http::status::ok, MimeType::APP_JSON};
 	}
 
-    template<typename Send>
-	ResponseData HandleTickRequest(std::string_view body, Send&& send) {
-    	json::object json_body;
+    template <typename Body, typename Allocator, typename Send>
+    void HandleTickRequest(const RouteMatch& route, const http::request<Body, http::basic_fields<Allocator>>& req,
+                           Send&& send, std::function<void(ResponseData&&)> handle) {
+    	if (auto_tick_)
+        	return handle(HttpResponseFactory::HandleBadRequest(std::forward<Send>(send)));
+
+    	if (!route.method_allowed)
+        	return handle(HttpResponseFactory::HandleMethodNotAllowed(std::forward<Send>(send), route.allow));
 
+    	JsonArena arena;
+    	json::value json_body(arena.GetStorage());
     	try {
-        	json_body = json::parse(body.data()).as_object();
+        	json_body = json::parse(req.body(), arena.GetStorage());
     	} catch (...) {
+        	// Ошибка разбора обрабатывается ниже: json_body остаётся null
+    	}
+
+    	const auto* json_object = json_body.if_object();
+    	if (json_object == nullptr) {
         	HttpResponseFactory::HandleAPIResponse(
             	http::status::bad_request,
             	RequestHttpBody::TICK_PARSE_ERROR,
             	std::forward<Send>(send)
         	);
-        	return { http::status::bad_request, MimeType::APP_JSON };
+        	return handle({ http::status::bad_request, MimeType::APP_JSON });
     	}
 
-    	auto tick = json_body.find("timeDelta");
+    	auto tick = json_object->find("timeDelta");
 
-    	if (tick == json_body.end() || !tick->value().is_int64()) {
+    	if (tick == json_object->end() || !tick->value().is_int64() || tick->value().get_int64() < 1) {
         	HttpResponseFactory::HandleAPIResponse(
             	http::status::bad_request,
             	RequestHttpBody::TICK_PARSE_ERROR,
             	std::forward<Send>(send)
         	);
-        	return { http::status::bad_request, MimeType::APP_JSON };
+        	return handle({ http::status::bad_request, MimeType::APP_JSON });
     	}
 
-    	int tick_val = static_cast<int>(tick->value().get_int64());
-
-    	if (tick_val < 1) {
+    	// Ответ отправляется, когда тик завершится во всех сессиях. Трасса запроса в задачи тика
+    	// не попадает, отметка RESPONSE ставится в ней здесь
+    	Tick(static_cast<unsigned>(tick->value().get_int64()), [trace = http_server::Tracer::Current()
+                                                              , send_ = std::forward<Send>(send), handle_ = std::move(handle)]() mutable {
+        	http_server::Tracer::Scope scope(std::move(trace));
         	HttpResponseFactory::HandleAPIResponse(
-            	http::status::bad_request,
-            	RequestHttpBody::TICK_PARSE_ERROR,
-            	std::forward<Send>(send)
+            	http::status::ok,
+            	"{}"sv,
+            	std::move(send_)
         	);
-        	return { http::status::bad_request, MimeType::APP_JSON };
+        	handle_({ http::status::ok, MimeType::APP_JSON });
+    	});
+	}
+
+    // Пакет действий: POST /api/v1/game/player/actions с телом [{"token": "...", "move": "U"}, ...].
+    // Пакет проверяется целиком до применения, поэтому при любой ошибке не выполняется ни одно
+    // действие. Все игроки пакета должны быть в одной сессии: действия применяются за один
+    // переход в её strand и попадают в один тик
+    template <typename Body, typename Allocator, typename Send>
+    void HandleBatchActionRequest(const RouteMatch& route, const http::request<Body, http::basic_fields<Allocator>>& req,
+                                  Send&& send, std::function<void(ResponseData&&)> handle) {
+    	if (!route.method_allowed)
+        	return handle(HttpResponseFactory::HandleMethodNotAllowed(std::forward<Send>(send), route.allow));
+
+    	const auto reply = [&send, &handle](http::status status, std::string_view body) {
+        	HttpResponseFactory::HandleAPIResponse(status, body, std::forward<Send>(send));
+        	handle({ status, MimeType::APP_JSON });
+    	};
+
+    	if (req.base()[http::field::content_type] != MimeType::APP_JSON)
+        	return reply(http::status::bad_request, RequestHttpBody::INVALID_CONTENT_TYPE);
+
+    	std::vector<PlayerAction> actions;
+    	switch (ParseBatchActions(req.body(), actions)) {
+    	case BatchParseResult::OK:
+        	break;
+    	case BatchParseResult::UNKNOWN_TOKEN:
+        	return reply(http::status::unauthorized, RequestHttpBody::TOKEN_UNKNOWN);
+    	case BatchParseResult::SESSION_MISMATCH:
+        	return reply(http::status::bad_request, RequestHttpBody::ACTIONS_SESSION_MISMATCH);
+    	default:
+        	return reply(http::status::bad_request, RequestHttpBody::ACTION_PARSE_ERROR);
     	}
 
-    	app_.Tick(tick_val);
+    	if (actions.empty())
+        	return reply(http::status::ok, "{}"sv);
 
-    	HttpResponseFactory::HandleAPIResponse(
-        	http::status::ok,
-        	"{}"sv,
-        	std::forward<Send>(send)
-    	);
+    	const auto* session = actions.front().player->GetSession();
+    	DispatchToSession(*session, [self = shared_from_this(), actions = std::move(actions)
+                                                  , send_ = std::forward<Send>(send), handle_ = std::move(handle)]() mutable {
+        	for (const auto& action : actions)
+            	self->ApplyAction(action);
 
-    	return { http::status::ok, MimeType::APP_JSON };
+        	HttpResponseFactory::HandleAPIResponse(
+            	http::status::ok,
+            	"{}"sv,
+            	std::move(send_)
+        	);
+        	handle_({ http::status::ok, MimeType::APP_JSON });
+    	});
 	}
 
+    // Действие игрока. Пустое направление означает остановку
+    struct PlayerAction {
+        app::Player* player;
+        std::optional<model::Direction> direction;
+    };
+
+    enum class BatchParseResult {
+        OK,
+        PARSE_ERROR,
+        UNKNOWN_TOKEN,
+        SESSION_MISMATCH
+    };
+
+    // Ограничение размера пакета, чтобы один запрос не занимал strand сессии надолго
+    static constexpr size_t MAX_BATCH_ACTIONS = 1024;
+
+    BatchParseResult ParseBatchActions(std::string_view body, std::vector<PlayerAction>& actions) const;
+    // "U", "D", "L", "R" или пустая строка для остановки
+    static bool ParseMove(std::string_view move, std::optional<model::Direction>& direction);
+    // Выполняется в strand сессии игрока
+    void ApplyAction(const PlayerAction& action);
+
     bool ParseBearer(const std::string_view auth_header, std::string& token_to_write) const;
+    // Токен из списка подпротоколов WebSocket: "game-state, token.<токен>"
+    bool ParseProtocolToken(std::string_view protocols, std::string& token_to_write) const;
 };
 
 
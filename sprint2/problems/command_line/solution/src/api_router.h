@@ -0,0 +1,206 @@
+#pragma once
+
+// boost.beast будет использовать std::string_view вместо boost::string_view
+#define BOOST_BEAST_USE_STD_STRING_VIEW
+
+#include <boost/beast/http/verb.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace http_handler {
+
+using namespace std::literals;
+
+struct RestApiLiteral {
+    RestApiLiteral() = delete;
+    constexpr static std::string_view API_V1 = "/api/v1/"sv;
+    constexpr static std::string_view MAPS = "maps"sv;
+    constexpr static std::string_view MAP = "map"sv;
+    constexpr static std::string_view GAME = "game"sv;
+    constexpr static std::string_view JOIN = "join"sv;
+    constexpr static std::string_view PLAYERS = "players"sv;
+    constexpr static std::string_view STATE = "state"sv;
+    constexpr static std::string_view PLAYER = "player"sv;
+    constexpr static std::string_view ACTION = "action"sv;
+    constexpr static std::string_view ACTIONS = "actions"sv;
+    constexpr static std::string_view TICK = "tick"sv;
+    constexpr static std::string_view SINCE = "since"sv;
+    // Подпротокол WebSocket подписки на состояние. Браузер не может задать заголовок
+    // Authorization, поэтому токен передаётся вторым подпротоколом вида token.<токен>
+    constexpr static std::string_view WS_PROTOCOL = "game-state"sv;
+    constexpr static std::string_view WS_TOKEN_PREFIX = "token."sv;
+};
+
+enum class ApiRoute {
+    NOT_FOUND,
+    MAP_LIST,
+    MAP,
+    JOIN,
+    PLAYERS,
+    STATE,
+    ACTION,
+    // Пакет действий нескольких игроков одной сессии
+    ACTIONS,
+    TICK
+};
+
+// Результат сопоставления запроса с таблицей маршрутов.
+// Строки ссылаются на цель запроса и живут, пока жива она
+struct RouteMatch {
+    ApiRoute route = ApiRoute::NOT_FOUND;
+    // Значение параметра пути, например идентификатор карты
+    std::string_view param;
+    std::string_view query;
+    bool method_allowed = false;
+    // Значение заголовка Allow для ответа 405
+    std::string_view allow;
+};
+
+// Маршрутизатор API. Таблица маршрутов собирается из RestApiLiteral на этапе компиляции,
+// сопоставление выполняется без выделения памяти: путь режется на фрагменты в массив
+// на стеке и сравнивается с маршрутами нужной длины
+class ApiRouter {
+public:
+    static constexpr RouteMatch Match(std::string_view target, boost::beast::http::verb method) noexcept;
+
+private:
+    static constexpr size_t MAX_SEGMENTS = 3;
+
+    enum Methods : uint8_t {
+        ANY = 0,
+        GET = 1 << 0,
+        HEAD = 1 << 1,
+        POST = 1 << 2
+    };
+
+    struct Route {
+        std::array<std::string_view, MAX_SEGMENTS> path;
+        size_t size;
+        // Последний фрагмент пути - параметр, пустая строка в path
+        bool has_param;
+        ApiRoute route;
+        uint8_t methods;
+        std::string_view allow;
+    };
+
+    static constexpr uint8_t MethodBit(boost::beast::http::verb method) noexcept {
+        switch (method) {
+        case boost::beast::http::verb::get:
+            return GET;
+        case boost::beast::http::verb::head:
+            return HEAD;
+        case boost::beast::http::verb::post:
+            return POST;
+        default:
+            return 0;
+        }
+    }
+
+    static constexpr std::array<Route, 9> ROUTES = {{
+        {{RestApiLiteral::MAPS}, 1, false, ApiRoute::MAP_LIST, ANY, {}},
+        {{RestApiLiteral::MAPS, {}}, 2, true, ApiRoute::MAP, ANY, {}},
+        {{RestApiLiteral::MAP, {}}, 2, true, ApiRoute::MAP, ANY, {}},
+        {{RestApiLiteral::GAME, RestApiLiteral::JOIN}, 2, false, ApiRoute::JOIN, POST, "POST"sv},
+        {{RestApiLiteral::GAME, RestApiLiteral::PLAYERS}, 2, false, ApiRoute::PLAYERS, GET | HEAD, "GET, HEAD"sv},
+        {{RestApiLiteral::GAME, RestApiLiteral::STATE}, 2, false, ApiRoute::STATE, GET | HEAD, "GET, HEAD"sv},
+        {{RestApiLiteral::GAME, RestApiLiteral::PLAYER, RestApiLiteral::ACTION}, 3, false, ApiRoute::ACTION, POST, "POST"sv},
+        {{RestApiLiteral::GAME, RestApiLiteral::PLAYER, RestApiLiteral::ACTIONS}, 3, false, ApiRoute::ACTIONS, POST, "POST"sv},
+        {{RestApiLiteral::GAME, RestApiLiteral::TICK}, 2, false, ApiRoute::TICK, POST, "POST"sv},
+    }};
+};
+
+constexpr RouteMatch ApiRouter::Match(std::string_view target, boost::beast::http::verb method) noexcept {
+    if (!target.starts_with(RestApiLiteral::API_V1))
+        return {};
+
+    const size_t query_pos = target.find('?');
+    std::string_view path = target.substr(RestApiLiteral::API_V1.size(),
+        query_pos == std::string_view::npos ? query_pos : query_pos - RestApiLiteral::API_V1.size());
+
+    RouteMatch result;
+    if (query_pos != std::string_view::npos)
+        result.query = target.substr(query_pos + 1);
+
+    std::array<std::string_view, MAX_SEGMENTS> segments{};
+    size_t size = 0;
+    for (;;) {
+        if (size == MAX_SEGMENTS)
+            return {};
+        const size_t slash = path.find('/');
+        segments[size++] = path.substr(0, slash);
+        if (slash == std::string_view::npos)
+            break;
+        path.remove_prefix(slash + 1);
+    }
+
+    for (const auto& route : ROUTES) {
+        if (route.size != size)
+            continue;
+
+        bool matches = true;
+        for (size_t i = 0; i < size && matches; ++i) {
+            if (route.has_param && i + 1 == size)
+                matches = !segments[i].empty();
+            else
+                matches = segments[i] == route.path[i];
+        }
+        if (!matches)
+            continue;
+
+        result.route = route.route;
+        if (route.has_param)
+            result.param = segments[size - 1];
+        result.method_allowed = route.methods == ANY || (route.methods & MethodBit(method)) != 0;
+        result.allow = route.allow;
+        return result;
+    }
+    return {};
+}
+
+static_assert(ApiRouter::Match("/api/v1/maps"sv, boost::beast::http::verb::get).route == ApiRoute::MAP_LIST);
+static_assert(ApiRouter::Match("/api/v1/maps/map1"sv, boost::beast::http::verb::get).param == "map1"sv);
+static_assert(ApiRouter::Match("/api/v1/game/state?since=1"sv, boost::beast::http::verb::get).query == "since=1"sv);
+static_assert(!ApiRouter::Match("/api/v1/game/join"sv, boost::beast::http::verb::get).method_allowed);
+static_assert(ApiRouter::Match("/api/v1/game/player/actions"sv, boost::beast::http::verb::post).route == ApiRoute::ACTIONS);
+static_assert(ApiRouter::Match("/api/v1/game/player"sv, boost::beast::http::verb::post).route == ApiRoute::NOT_FOUND);
+
+// Раскодирует %XX и '+' в цели запроса. Если экранированных символов нет, возвращает
+// исходную строку без копирования, иначе раскодирует её в buffer и возвращает ссылку на него
+inline std::string_view DecodeTarget(std::string_view target, std::string& buffer) {
+    // find_first_of вызывает поиск по набору символов для каждой позиции, простой цикл быстрее
+    if (std::none_of(target.begin(), target.end(), [](char c) { return c == '%' || c == '+'; }))
+        return target;
+
+    const auto hex_to_int = [](char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    };
+
+    buffer.clear();
+    buffer.reserve(target.size());
+    for (size_t i = 0; i < target.size(); ++i) {
+        if (target[i] == '%' && i + 2 < target.size()) {
+            const int hi = hex_to_int(target[i + 1]);
+            const int lo = hex_to_int(target[i + 2]);
+            if (hi == -1 || lo == -1) {
+                buffer += target[i];
+            } else {
+                buffer += static_cast<char>((hi << 4) | lo);
+                i += 2;
+            }
+        } else if (target[i] == '+') {
+            buffer += ' ';
+        } else {
+            buffer += target[i];
+        }
+    }
+    return buffer;
+}
+
+}  // namespace http_handler
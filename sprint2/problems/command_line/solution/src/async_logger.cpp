@@ -0,0 +1,146 @@
+#include "async_logger.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <ctime>
+
+namespace http_handler {
+
+using namespace std::literals;
+
+namespace {
+
+static_assert((AsyncLogger::CAPACITY & (AsyncLogger::CAPACITY - 1)) == 0, "capacity must be a power of two");
+
+// Местное время в формате ISO 8601 с микросекундами, как у to_iso_extended_string
+void AppendTimestamp(std::string& out, std::chrono::system_clock::time_point time) {
+    using namespace std::chrono;
+    const std::time_t seconds = system_clock::to_time_t(time);
+    const auto micros = duration_cast<microseconds>(time.time_since_epoch()).count() % 1'000'000;
+
+    std::tm tm{};
+    localtime_r(&seconds, &tm);
+    char buffer[48];
+    size_t size = std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S", &tm);
+    size += std::snprintf(buffer + size, sizeof(buffer) - size, ".%06lld", static_cast<long long>(micros));
+    out.append(buffer, size);
+}
+
+}  // namespace
+
+AsyncLogger::AsyncLogger()
+    : slots_(std::make_unique<Slot[]>(CAPACITY)) {
+    for (size_t i = 0; i < CAPACITY; ++i)
+        slots_[i].sequence.store(i, std::memory_order_relaxed);
+    writer_ = std::thread([this] { Run(); });
+}
+
+AsyncLogger::~AsyncLogger() {
+    Stop();
+}
+
+void AsyncLogger::Push(std::string_view message, std::string_view data) {
+    const auto now = std::chrono::system_clock::now();
+    TryPush([&](Record& record) {
+        record.time = now;
+        record.message = message;
+        record.text.assign(data);
+        record.formatted = false;
+    });
+}
+
+void AsyncLogger::PushLine(std::string_view line) {
+    TryPush([&](Record& record) {
+        record.text.assign(line);
+        record.formatted = true;
+    });
+}
+
+template <typename Fill>
+void AsyncLogger::TryPush(Fill&& fill) {
+    // Ограниченная очередь Вьюкова: номер в ячейке показывает, свободна ли она для позиции pos
+    size_t pos = tail_.load(std::memory_order_relaxed);
+    for (;;) {
+        Slot& slot = slots_[pos & (CAPACITY - 1)];
+        const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        const auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+        if (diff == 0) {
+            if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                fill(slot.record);
+                slot.sequence.store(pos + 1, std::memory_order_release);
+                return;
+            }
+        } else if (diff < 0) {
+            // Кольцо заполнено: поток вывода не успевает
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            pos = tail_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool AsyncLogger::TryPop(std::string& batch) {
+    Slot& slot = slots_[head_ & (CAPACITY - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != head_ + 1)
+        return false;
+
+    const Record& record = slot.record;
+    if (record.formatted) {
+        batch += record.text;
+    } else {
+        batch += "{\"timestamp\":\""sv;
+        AppendTimestamp(batch, record.time);
+        batch += "\", \"data\":"sv;
+        batch += record.text;
+        batch += ", \"message\":\""sv;
+        batch += record.message;
+        batch += "\"}"sv;
+    }
+    batch += '\n';
+
+    slot.sequence.store(head_ + CAPACITY, std::memory_order_release);
+    ++head_;
+    return true;
+}
+
+void AsyncLogger::Run() {
+    std::string batch;
+    for (;;) {
+        // Флаг читается до выборки: записи, добавленные до Stop, будут выведены
+        const bool stopping = stopping_.load(std::memory_order_acquire);
+
+        size_t count = 0;
+        while (count < MAX_BATCH && TryPop(batch))
+            ++count;
+
+        if (count > 0) {
+            std::fwrite(batch.data(), 1, batch.size(), stdout);
+            std::fflush(stdout);
+            batch.clear();
+            written_.fetch_add(count, std::memory_order_relaxed);
+            batches_.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        if (stopping)
+            return;
+        std::this_thread::sleep_for(FLUSH_INTERVAL);
+    }
+}
+
+void AsyncLogger::Stop() {
+    stopping_.store(true, std::memory_order_release);
+    if (writer_.joinable())
+        writer_.join();
+}
+
+AsyncLogger::Stats AsyncLogger::GetStats() const noexcept {
+    return {
+        written_.load(std::memory_order_relaxed),
+        dropped_.load(std::memory_order_relaxed),
+        batches_.load(std::memory_order_relaxed)
+    };
+}
+
+}  // namespace http_handler
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <boost/log/sinks/basic_sink_backend.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace http_handler {
+
+// Асинхронный журнал. Потоки сервера кладут готовые записи в ограниченное кольцо
+// без блокировок (MPSC), отдельный поток забирает их пачками, дописывает метку
+// времени и пишет в stdout одним вызовом на пачку. Если кольцо заполнено, запись
+// отбрасывается и учитывается в счётчике dropped: поток сервера никогда не ждёт вывода
+class AsyncLogger {
+public:
+    static constexpr size_t CAPACITY = 8192;
+    static constexpr size_t MAX_BATCH = 1024;
+    static constexpr std::chrono::milliseconds FLUSH_INTERVAL{5};
+
+    struct Stats {
+        uint64_t written = 0;
+        uint64_t dropped = 0;
+        uint64_t batches = 0;
+    };
+
+    AsyncLogger();
+    ~AsyncLogger();
+
+    AsyncLogger(const AsyncLogger&) = delete;
+    AsyncLogger& operator=(const AsyncLogger&) = delete;
+
+    // Запись вида {"timestamp":"...", "data":<data>, "message":"<message>"}.
+    // data - готовый JSON, message - строка без экранируемых символов, живущая всё время работы
+    void Push(std::string_view message, std::string_view data);
+    // Полностью отформатированная строка журнала без перевода строки
+    void PushLine(std::string_view line);
+
+    // Записывает оставшиеся записи и останавливает поток вывода
+    void Stop();
+
+    Stats GetStats() const noexcept;
+
+private:
+    struct Record {
+        std::chrono::system_clock::time_point time;
+        std::string_view message;
+        // Данные записи или вся строка, если formatted. Ёмкость строки сохраняется
+        // между использованиями ячейки, поэтому запись в кольцо не выделяет память
+        std::string text;
+        bool formatted = false;
+    };
+
+    struct Slot {
+        std::atomic<size_t> sequence;
+        Record record;
+    };
+
+    template <typename Fill>
+    void TryPush(Fill&& fill);
+    bool TryPop(std::string& batch);
+    void Run();
+
+    std::unique_ptr<Slot[]> slots_;
+    alignas(64) std::atomic<size_t> tail_{0};
+    // Читается только потоком вывода
+    alignas(64) size_t head_ = 0;
+
+    alignas(64) std::atomic<uint64_t> written_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> batches_{0};
+    std::atomic<bool> stopping_{false};
+    std::thread writer_;
+};
+
+// Приёмник Boost.Log, передающий отформатированные записи в AsyncLogger.
+// Через него идут редкие служебные сообщения, чтобы весь вывод шёл одним потоком
+class AsyncLogSinkBackend : public boost::log::sinks::basic_formatted_sink_backend<char, boost::log::sinks::concurrent_feeding> {
+public:
+    explicit AsyncLogSinkBackend(AsyncLogger& logger)
+        : logger_(logger) {
+    }
+
+    void consume(const boost::log::record_view&, const string_type& line) {
+        logger_.PushLine(line);
+    }
+
+private:
+    AsyncLogger& logger_;
+};
+
+}  // namespace http_handler
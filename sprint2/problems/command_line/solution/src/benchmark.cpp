@@ -0,0 +1,405 @@
+// Набор микробенчмарков игрового сервера.
+// Запуск: game_benchmark [размер сетки дорог] [длина дороги]
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/json.hpp>
+
+#include "api_router.h"
+#include "binary_state.h"
+#include "handler_utils.h"
+#include "json_arena.h"
+#include "json_writer.h"
+#include "model.h"
+
+using namespace std::literals;
+
+// Счётчик обращений к куче: бенчмарк разбора запросов сравнивает их число на запрос
+static size_t heap_allocations = 0;
+
+void* operator new(std::size_t size) {
+    ++heap_allocations;
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double ElapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void PrintRow(std::string_view name, double ms, size_t bytes) {
+    std::cout << std::left << std::setw(28) << name
+              << std::right << std::setw(12) << std::fixed << std::setprecision(2) << ms << " ms"
+              << std::setw(14) << bytes / 1024 << " KiB" << std::endl;
+}
+
+// Карта-сетка: grid горизонтальных и grid вертикальных дорог длиной length
+model::Map GenerateGridMap(int grid, int length) {
+    model::Map map{model::Map::Id{"bench"s}, "Benchmark map"s};
+    map.SetSpeed(1.);
+    const int step = std::max(1, length / std::max(1, grid - 1));
+    for (int i = 0; i < grid; ++i) {
+        map.AddRoad(model::Road{model::Road::HORIZONTAL, {0, i * step}, length});
+        map.AddRoad(model::Road{model::Road::VERTICAL, {i * step, 0}, length});
+    }
+    return map;
+}
+
+// Прежняя реализация поиска дорог: запись на каждую целочисленную точку каждой дороги
+struct LegacyRoadsGraph {
+    struct PointHash {
+        size_t operator()(const model::Point& p) const {
+            return std::hash<int>{}(p.x) ^ (std::hash<int>{}(p.y) << 1);
+        }
+    };
+
+    std::unordered_map<model::Point, std::vector<const model::Road*>, PointHash> graph;
+
+    explicit LegacyRoadsGraph(const model::Map& map) {
+        for (const auto& road : map.GetRoads()) {
+            const auto start = road.GetStart();
+            const auto end = road.GetEnd();
+            if (road.IsHorizontal()) {
+                for (int x = std::min(start.x, end.x); x <= std::max(start.x, end.x); ++x)
+                    graph[{x, start.y}].push_back(&road);
+            } else {
+                for (int y = std::min(start.y, end.y); y <= std::max(start.y, end.y); ++y)
+                    graph[{start.x, y}].push_back(&road);
+            }
+        }
+    }
+
+    // Оценка памяти: узел хеш-таблицы, буфер вектора и служебные данные malloc
+    size_t GetMemoryUsage() const {
+        constexpr size_t malloc_overhead = 16;
+        size_t bytes = graph.bucket_count() * sizeof(void*);
+        for (const auto& [point, roads] : graph) {
+            bytes += sizeof(void*) + sizeof(size_t) + sizeof(point) + sizeof(roads) + malloc_overhead;
+            bytes += roads.capacity() * sizeof(const model::Road*) + malloc_overhead;
+        }
+        return bytes;
+    }
+};
+
+void BenchmarkRoadIndex(int grid, int length) {
+    std::cout << "== Road index: " << grid << "x" << grid << " roads of length " << length << " ==" << std::endl;
+
+    const model::Map source = GenerateGridMap(grid, length);
+
+    auto start = Clock::now();
+    const LegacyRoadsGraph legacy{source};
+    PrintRow("legacy per-cell build"sv, ElapsedMs(start), legacy.GetMemoryUsage());
+
+    model::Map map = source;
+    start = Clock::now();
+    map.BuildRoadIndex();
+    PrintRow("road index + graph build"sv, ElapsedMs(start),
+             map.GetRoadIndex().GetMemoryUsage() + map.GetRoadGraph().GetMemoryUsage());
+
+    // Запуск сервера целиком: загрузка карты в игру и создание сессии
+    start = Clock::now();
+    model::Game game;
+    game.AddMap(source);
+    game.StartSessions(false);
+    PrintRow("game startup"sv, ElapsedMs(start), game.GetMaps().front().GetRoadIndex().GetMemoryUsage());
+
+    constexpr size_t queries = 1'000'000;
+    std::mt19937 generator{42};
+    std::uniform_int_distribution<int> coord{0, length};
+    std::vector<model::Point> points(queries);
+    for (auto& p : points)
+        p = {coord(generator), coord(generator)};
+
+    size_t found = 0;
+    start = Clock::now();
+    for (const auto& p : points) {
+        if (auto it = legacy.graph.find(p); it != legacy.graph.end())
+            found += it->second.size();
+    }
+    PrintRow("legacy 1M lookups"sv, ElapsedMs(start), 0);
+
+    size_t indexed = 0;
+    start = Clock::now();
+    for (const auto& p : points) {
+        map.GetRoadIndex().ForEachRoadAt(p.x, p.y, [&indexed](auto) {
+            ++indexed;
+            return false;
+        });
+    }
+    PrintRow("road index 1M lookups"sv, ElapsedMs(start), 0);
+
+    if (found != indexed)
+        std::cout << "MISMATCH: legacy found " << found << " roads, index found " << indexed << std::endl;
+}
+
+// Прежняя маршрутизация. URLDecode и HexToInt - дословные копии методов RequestHandler,
+// удалённых вместе с ними, путь режется той же utils::SplitRequest, что и раньше,
+// дальше идёт цепочка сравнений фрагментов из APIHandler::ProcessRequest
+struct LegacyRouter {
+    static int HexToInt(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'A' && c <= 'F') return 10 + c - 'A';
+        if (c >= 'a' && c <= 'f') return 10 + c - 'a';
+        return -1;
+    }
+
+    static std::string URLDecode(std::string_view url) {
+        std::string result;
+        result.reserve(url.size());
+        for (size_t i = 0; i < url.size(); ++i) {
+            if (url[i] == '%') {
+                if (i + 2 < url.size()) {
+                    int hi = HexToInt(url[i+1]);
+                    int lo = HexToInt(url[i+2]);
+                    if (hi == -1 || lo == -1) {
+                        result += url[i];
+                    } else {
+                        result += static_cast<char>((hi << 4) | lo);
+                        i += 2;
+                    }
+                } else {
+                    result += url[i];
+                }
+            } else if (url[i] == '+') {
+                result += ' ';
+            } else {
+                result += url[i];
+            }
+        }
+        return result;
+    }
+
+    static http_handler::ApiRoute Match(std::string_view raw_target, std::string_view method) {
+        using http_handler::ApiRoute;
+        using http_handler::RestApiLiteral;
+
+        const std::string string_target = URLDecode(raw_target);
+        const std::string_view target = string_target;
+        const size_t query_pos = target.find('?');
+        const auto path_segments = http_handler::utils::SplitRequest(
+            target.substr(1, query_pos == std::string_view::npos ? query_pos : query_pos - 1));
+        if (path_segments.size() < 3)
+            return ApiRoute::NOT_FOUND;
+
+        const auto& resource = path_segments[2];
+        if (resource == RestApiLiteral::MAPS)
+            return path_segments.size() == 4 ? ApiRoute::MAP : ApiRoute::MAP_LIST;
+        if (resource == RestApiLiteral::MAP)
+            return ApiRoute::MAP;
+        if (resource != RestApiLiteral::GAME || path_segments.size() < 4)
+            return ApiRoute::NOT_FOUND;
+
+        const auto& action = path_segments[3];
+        if (action == RestApiLiteral::JOIN && method == "POST")
+            return ApiRoute::JOIN;
+        if (action == RestApiLiteral::PLAYERS && (method == "GET" || method == "HEAD"))
+            return ApiRoute::PLAYERS;
+        if (action == RestApiLiteral::STATE && (method == "GET" || method == "HEAD"))
+            return ApiRoute::STATE;
+        if (action == RestApiLiteral::PLAYER && path_segments.size() > 4 && path_segments[4] == RestApiLiteral::ACTION)
+            return ApiRoute::ACTION;
+        if (action == RestApiLiteral::TICK)
+            return ApiRoute::TICK;
+        return ApiRoute::NOT_FOUND;
+    }
+};
+
+void BenchmarkRouting() {
+    using boost::beast::http::verb;
+
+    std::cout << "== API routing ==" << std::endl;
+
+    struct Request {
+        std::string_view target;
+        verb method;
+        std::string_view method_string;
+    };
+    constexpr std::array<Request, 6> requests = {{
+        {"/api/v1/game/state"sv, verb::get, "GET"sv},
+        {"/api/v1/game/state?since=42"sv, verb::get, "GET"sv},
+        {"/api/v1/game/player/action"sv, verb::post, "POST"sv},
+        {"/api/v1/game/players"sv, verb::get, "GET"sv},
+        {"/api/v1/maps/map1"sv, verb::get, "GET"sv},
+        {"/api/v1/maps/town%20center"sv, verb::get, "GET"sv},
+    }};
+
+    constexpr size_t iterations = 1'000'000;
+
+    size_t legacy_checksum = 0;
+    auto start = Clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        const auto& request = requests[i % requests.size()];
+        legacy_checksum += static_cast<size_t>(LegacyRouter::Match(request.target, request.method_string));
+    }
+    const double legacy_ms = ElapsedMs(start);
+    PrintRow("legacy routing 1M"sv, legacy_ms, 0);
+
+    size_t checksum = 0;
+    start = Clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        const auto& request = requests[i % requests.size()];
+        std::string decoded;
+        const auto match = http_handler::ApiRouter::Match(http_handler::DecodeTarget(request.target, decoded), request.method);
+        checksum += static_cast<size_t>(match.route);
+    }
+    const double router_ms = ElapsedMs(start);
+    PrintRow("route table 1M"sv, router_ms, 0);
+
+    std::cout << "per request: legacy " << legacy_ms * 1e6 / iterations << " ns, route table "
+              << router_ms * 1e6 / iterations << " ns" << std::endl;
+    if (checksum != legacy_checksum)
+        std::cout << "MISMATCH: legacy checksum " << legacy_checksum << ", route table checksum " << checksum << std::endl;
+}
+
+// Прежняя сериализация состояния: построение json::object и json::serialize
+std::string SerializeStateDom(const std::vector<const model::Dog*>& dogs) {
+    namespace json = boost::json;
+
+    json::object players;
+    for (const auto* dog : dogs) {
+        json::object dog_data;
+
+        const auto pos = dog->GetPosition();
+        dog_data["pos"] = json::array{ pos.x, pos.y };
+
+        const auto speed = dog->GetSpeed();
+        dog_data["speed"] = json::array{ speed.vx, speed.vy };
+
+        switch (dog->GetDirection()) {
+            case model::Direction::NORTH: dog_data["dir"] = "U"; break;
+            case model::Direction::SOUTH: dog_data["dir"] = "D"; break;
+            case model::Direction::EAST:  dog_data["dir"] = "R"; break;
+            case model::Direction::WEST:  dog_data["dir"] = "L"; break;
+        }
+        players[std::to_string(dog->GetId())] = std::move(dog_data);
+    }
+
+    json::object state;
+    state["players"] = std::move(players);
+    return json::serialize(state);
+}
+
+void BenchmarkStateSerialization() {
+    std::cout << "== State serialization ==" << std::endl;
+
+    for (const int dog_count : {10, 100, 1000}) {
+        model::Game game;
+        game.AddMap(GenerateGridMap(10, 100));
+        game.StartSessions(true);
+        auto& session = game.GetSessions().front();
+
+        // Собаки разбегаются в разные стороны, чтобы координаты были дробными
+        for (int i = 0; i < dog_count; ++i) {
+            auto* dog = session.AddDog(model::Dog{"dog "s + std::to_string(i)});
+            dog->Move(static_cast<model::Direction>(i % 4), 1.3);
+        }
+        session.Tick(1234);
+
+        const auto dogs = session.GetDogs();
+        const size_t iterations = 1'000'000 / dog_count;
+
+        std::string dom_body;
+        auto start = Clock::now();
+        for (size_t i = 0; i < iterations; ++i)
+            dom_body = SerializeStateDom(dogs);
+        PrintRow("dom "s + std::to_string(dog_count) + " dogs", ElapsedMs(start), dom_body.size());
+
+        std::string body;
+        start = Clock::now();
+        for (size_t i = 0; i < iterations; ++i) {
+            body.clear();
+            http_handler::json_writer::WriteState(body, dogs);
+        }
+        PrintRow("writer "s + std::to_string(dog_count) + " dogs", ElapsedMs(start), body.size());
+
+        std::string binary_body;
+        start = Clock::now();
+        for (size_t i = 0; i < iterations; ++i) {
+            binary_body.clear();
+            http_handler::binary_state::WriteState(binary_body, dogs, session.GetTickNumber());
+        }
+        PrintRow("binary "s + std::to_string(dog_count) + " dogs", ElapsedMs(start), binary_body.size());
+        std::cout << "body size: json " << body.size() << " B, binary " << binary_body.size() << " B" << std::endl;
+
+        if (body != dom_body)
+            std::cout << "MISMATCH: writer output differs from json::serialize for " << dog_count << " dogs" << std::endl;
+    }
+}
+
+// Разбор тел запросов как в обработчиках API: с ресурсом памяти по умолчанию и в JsonArena
+void BenchmarkRequestParsing() {
+    namespace json = boost::json;
+
+    std::cout << "== Request JSON parsing ==" << std::endl;
+
+    std::string batch = "["s;
+    for (int i = 0; i < 16; ++i) {
+        if (i != 0)
+            batch += ',';
+        batch += R"({"token": "0123456789abcdef0123456789abcdef", "move": "L"})"sv;
+    }
+    batch += ']';
+
+    const std::array<std::pair<std::string_view, std::string_view>, 3> bodies = {{
+        {"join"sv, R"({"userName": "Scooby Doo", "mapId": "map1"})"sv},
+        {"action"sv, R"({"move": "L"})"sv},
+        {"actions x16"sv, batch},
+    }};
+
+    constexpr size_t iterations = 200'000;
+
+    for (const auto& [name, body] : bodies) {
+        size_t checksum = 0;
+        size_t allocations = heap_allocations;
+        auto start = Clock::now();
+        for (size_t i = 0; i < iterations; ++i)
+            checksum += json::parse(body).is_object();
+        PrintRow("heap "s + std::string{name}, ElapsedMs(start), 0);
+        const double heap_per_request = static_cast<double>(heap_allocations - allocations) / iterations;
+
+        allocations = heap_allocations;
+        start = Clock::now();
+        for (size_t i = 0; i < iterations; ++i) {
+            http_handler::JsonArena arena;
+            checksum += json::parse(body, arena.GetStorage()).is_object();
+        }
+        PrintRow("arena "s + std::string{name}, ElapsedMs(start), 0);
+        const double arena_per_request = static_cast<double>(heap_allocations - allocations) / iterations;
+
+        std::cout << "allocations per request: heap " << heap_per_request << ", arena " << arena_per_request
+                  << " (checksum " << checksum << ")" << std::endl;
+    }
+}
+
+}  // namespace
+
+int main(int argc, const char* argv[]) {
+    const int grid = argc > 1 ? std::stoi(argv[1]) : 100;
+    const int length = argc > 2 ? std::stoi(argv[2]) : 5000;
+
+    BenchmarkRoadIndex(grid, length);
+    BenchmarkRouting();
+    BenchmarkStateSerialization();
+    BenchmarkRequestParsing();
+}
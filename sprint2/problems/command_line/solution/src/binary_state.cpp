@@ -0,0 +1,57 @@
+#include "binary_state.h"
+
+#include <algorithm>
+#include <bit>
+
+namespace http_handler::binary_state {
+
+namespace {
+
+template <typename T>
+char* WriteLittleEndian(char* out, T value) {
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        *out++ = static_cast<char>(value & 0xFF);
+        value >>= 8;
+    }
+    return out;
+}
+
+char* WriteFloat(char* out, double value) {
+    return WriteLittleEndian(out, std::bit_cast<uint32_t>(static_cast<float>(value)));
+}
+
+char DirectionToChar(model::Direction dir) {
+    switch (dir) {
+        case model::Direction::NORTH: return 'U';
+        case model::Direction::SOUTH: return 'D';
+        case model::Direction::EAST:  return 'R';
+        case model::Direction::WEST:  return 'L';
+    }
+    return 0;
+}
+
+}  // namespace
+
+void WriteState(std::string& out, const std::vector<const model::Dog*>& dogs, uint64_t tick) {
+    const size_t offset = out.size();
+    out.resize(offset + HEADER_SIZE + dogs.size() * RECORD_SIZE);
+
+    char* p = out.data() + offset;
+    p = std::copy(MAGIC.begin(), MAGIC.end(), p);
+    p = WriteLittleEndian(p, static_cast<uint32_t>(dogs.size()));
+    p = WriteLittleEndian(p, tick);
+
+    for (const auto* dog : dogs) {
+        p = WriteLittleEndian(p, static_cast<uint32_t>(dog->GetId()));
+        *p++ = DirectionToChar(dog->GetDirection());
+
+        const auto pos = dog->GetPosition();
+        const auto speed = dog->GetSpeed();
+        p = WriteFloat(p, pos.x);
+        p = WriteFloat(p, pos.y);
+        p = WriteFloat(p, speed.vx);
+        p = WriteFloat(p, speed.vy);
+    }
+}
+
+}  // namespace http_handler::binary_state
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "model.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace http_handler {
+
+// Двоичное представление состояния сессии для клиентов, приславших
+// Accept: application/x-game-state. Все числа записываются в little-endian.
+//
+// Заголовок, 16 байт:
+//   char[4]  сигнатура "GST2"
+//   uint32   количество записей собак
+//   uint64   номер тика, начиная с которого состояние актуально: его можно передать
+//            в since следующего запроса
+// Запись собаки, 21 байт без выравнивания:
+//   uint32   идентификатор собаки
+//   uint8    направление: 'U', 'D', 'L' или 'R'
+//   float32  x, y, vx, vy
+// Точности float32 (24 бита мантиссы) хватает для координат карт до сотен тысяч единиц
+// с шагом меньше сотой, а запись почти вдвое короче, чем с float64
+//
+// Ответ на запрос с since имеет тот же формат и содержит только изменившихся собак
+namespace binary_state {
+    constexpr std::string_view MAGIC = "GST2";
+    constexpr size_t HEADER_SIZE = 16;
+    constexpr size_t RECORD_SIZE = 21;
+
+    void WriteState(std::string& out, const std::vector<const model::Dog*>& dogs, uint64_t tick);
+}
+
+}  // namespace http_handler
@@ -0,0 +1,85 @@
+#include "buffer_pool.h"
+
+#include <array>
+#include <bit>
+#include <vector>
+
+namespace http_server {
+
+namespace {
+
+constexpr size_t CLASS_COUNT = std::countr_zero(BufferPool::MAX_BLOCK) - std::countr_zero(BufferPool::MIN_BLOCK) + 1;
+
+// Номер класса для блока размера size, не больше MAX_BLOCK
+size_t ClassIndex(size_t size) noexcept {
+    if (size <= BufferPool::MIN_BLOCK)
+        return 0;
+    return std::bit_width(size - 1) - std::countr_zero(BufferPool::MIN_BLOCK);
+}
+
+constexpr size_t ClassSize(size_t index) noexcept {
+    return BufferPool::MIN_BLOCK << index;
+}
+
+struct FreeLists {
+    std::array<std::vector<void*>, CLASS_COUNT> blocks;
+
+    ~FreeLists() {
+        for (size_t i = 0; i < CLASS_COUNT; ++i) {
+            for (void* block : blocks[i])
+                ::operator delete(block, ClassSize(i));
+        }
+    }
+};
+
+thread_local FreeLists free_lists;
+
+// Счётчики в разных строках кеша, чтобы потоки не мешали друг другу
+alignas(64) std::atomic<uint64_t> hits{0};
+alignas(64) std::atomic<uint64_t> misses{0};
+
+}  // namespace
+
+void* BufferPool::Allocate(size_t size) {
+    if (size > MAX_BLOCK) {
+        misses.fetch_add(1, std::memory_order_relaxed);
+        return ::operator new(size);
+    }
+
+    const size_t index = ClassIndex(size);
+    auto& list = free_lists.blocks[index];
+    if (!list.empty()) {
+        void* block = list.back();
+        list.pop_back();
+        hits.fetch_add(1, std::memory_order_relaxed);
+        return block;
+    }
+
+    misses.fetch_add(1, std::memory_order_relaxed);
+    return ::operator new(ClassSize(index));
+}
+
+void BufferPool::Deallocate(void* ptr, size_t size) noexcept {
+    if (ptr == nullptr)
+        return;
+
+    if (size > MAX_BLOCK)
+        return ::operator delete(ptr, size);
+
+    const size_t index = ClassIndex(size);
+    auto& list = free_lists.blocks[index];
+    if (list.size() * ClassSize(index) >= MAX_FREE_BYTES_PER_CLASS)
+        return ::operator delete(ptr, ClassSize(index));
+
+    try {
+        list.push_back(ptr);
+    } catch (...) {
+        ::operator delete(ptr, ClassSize(index));
+    }
+}
+
+BufferPool::Stats BufferPool::GetStats() noexcept {
+    return { hits.load(std::memory_order_relaxed), misses.load(std::memory_order_relaxed) };
+}
+
+}  // namespace http_server
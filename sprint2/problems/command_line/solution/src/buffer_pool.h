@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace http_server {
+
+// Пул блоков памяти с классами размеров по степеням двойки от MIN_BLOCK до MAX_BLOCK.
+// Свободные блоки хранятся в списках потока, поэтому выделение и освобождение обходятся
+// без блокировок. Блок можно освободить в другом потоке: он попадёт в список этого потока.
+// Объём свободных блоков класса в потоке ограничен, лишние возвращаются в кучу.
+// Блоки больше MAX_BLOCK выделяются из кучи напрямую и считаются промахами
+class BufferPool {
+public:
+    static constexpr size_t MIN_BLOCK = 64;
+    static constexpr size_t MAX_BLOCK = 64 * 1024;
+    static constexpr size_t MAX_FREE_BYTES_PER_CLASS = 256 * 1024;
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+    };
+
+    BufferPool() = delete;
+
+    static void* Allocate(size_t size);
+    static void Deallocate(void* ptr, size_t size) noexcept;
+
+    static Stats GetStats() noexcept;
+};
+
+// Аллокатор поверх BufferPool для контейнеров и буферов beast
+template <typename T>
+class PoolAllocator {
+public:
+    using value_type = T;
+
+    PoolAllocator() noexcept = default;
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>&) noexcept {
+    }
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(BufferPool::Allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T* ptr, size_t n) noexcept {
+        BufferPool::Deallocate(ptr, n * sizeof(T));
+    }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U>&) const noexcept {
+        return true;
+    }
+};
+
+}  // namespace http_server
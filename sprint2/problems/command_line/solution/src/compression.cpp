@@ -0,0 +1,124 @@
+#include "compression.h"
+
+#include <boost/beast/zlib/deflate_stream.hpp>
+#include <boost/crc.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace http_handler {
+
+namespace zlib = boost::beast::zlib;
+
+namespace {
+
+constexpr int WINDOW_BITS = 15;
+constexpr int MEMORY_LEVEL = 8;
+
+// Заголовок gzip (RFC 1952) без имени файла и времени изменения, ОС не указана
+constexpr unsigned char GZIP_HEADER[] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff };
+// Заголовок zlib (RFC 1950): deflate с окном 32 КиБ, контрольные биты FCHECK
+constexpr unsigned char ZLIB_HEADER[] = { 0x78, 0x9c };
+
+uint32_t Adler32(std::string_view data) {
+    constexpr uint32_t MOD = 65521;
+    uint32_t a = 1;
+    uint32_t b = 0;
+    while (!data.empty()) {
+        // За 5552 байта сумма не переполняет 32 бита
+        const size_t block = std::min<size_t>(data.size(), 5552);
+        for (const unsigned char c : data.substr(0, block)) {
+            a += c;
+            b += a;
+        }
+        a %= MOD;
+        b %= MOD;
+        data.remove_prefix(block);
+    }
+    return (b << 16) | a;
+}
+
+void AppendLittleEndian(std::string& out, uint32_t value) {
+    for (int i = 0; i < 4; ++i)
+        out += static_cast<char>((value >> (8 * i)) & 0xff);
+}
+
+void AppendBigEndian(std::string& out, uint32_t value) {
+    for (int i = 3; i >= 0; --i)
+        out += static_cast<char>((value >> (8 * i)) & 0xff);
+}
+
+// Дописывает к out сырой поток deflate. Поток сжатия потока переиспользуется между вызовами
+void Deflate(std::string_view data, int level, std::string& out) {
+    thread_local zlib::deflate_stream stream;
+    stream.reset(level, WINDOW_BITS, MEMORY_LEVEL, zlib::Strategy::normal);
+
+    const size_t offset = out.size();
+    out.resize(offset + stream.upper_bound(data.size()));
+
+    zlib::z_params params;
+    params.next_in = data.data();
+    params.avail_in = data.size();
+    params.next_out = out.data() + offset;
+    params.avail_out = out.size() - offset;
+
+    boost::beast::error_code ec;
+    stream.write(params, zlib::Flush::finish, ec);
+    if (ec && ec != zlib::error::end_of_stream)
+        throw std::runtime_error("deflate failed: " + ec.message());
+
+    out.resize(offset + params.total_out);
+}
+
+}  // namespace
+
+ResponseCompressor::ResponseCompressor(int level)
+    : level_(std::clamp(level, 0, 9)) {
+}
+
+ContentEncoding ResponseCompressor::Negotiate(std::string_view accept_encoding) const {
+    if (level_ == 0 || accept_encoding.empty())
+        return ContentEncoding::IDENTITY;
+    if (utils::AcceptsEncoding(accept_encoding, "gzip"sv))
+        return ContentEncoding::GZIP;
+    if (utils::AcceptsEncoding(accept_encoding, "deflate"sv))
+        return ContentEncoding::DEFLATE;
+    return ContentEncoding::IDENTITY;
+}
+
+std::string ResponseCompressor::Compress(std::string_view data, ContentEncoding encoding) const {
+    std::string out;
+    switch (encoding) {
+    case ContentEncoding::GZIP: {
+        out.assign(std::begin(GZIP_HEADER), std::end(GZIP_HEADER));
+        Deflate(data, level_, out);
+        boost::crc_32_type crc;
+        crc.process_bytes(data.data(), data.size());
+        AppendLittleEndian(out, crc.checksum());
+        AppendLittleEndian(out, static_cast<uint32_t>(data.size()));
+        break;
+    }
+    case ContentEncoding::DEFLATE:
+        out.assign(std::begin(ZLIB_HEADER), std::end(ZLIB_HEADER));
+        Deflate(data, level_, out);
+        AppendBigEndian(out, Adler32(data));
+        break;
+    default:
+        out = data;
+        break;
+    }
+    return out;
+}
+
+std::string_view ResponseCompressor::GetName(ContentEncoding encoding) noexcept {
+    switch (encoding) {
+    case ContentEncoding::GZIP:
+        return "gzip"sv;
+    case ContentEncoding::DEFLATE:
+        return "deflate"sv;
+    default:
+        return "identity"sv;
+    }
+}
+
+}  // namespace http_handler
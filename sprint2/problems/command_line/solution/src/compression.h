@@ -0,0 +1,104 @@
+#pragma once
+
+#include "handler_utils.h"
+#include "shared_body.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace http_handler {
+
+enum class ContentEncoding {
+    IDENTITY,
+    GZIP,
+    // zlib-обёртка над deflate (RFC 1950), как требует HTTP
+    DEFLATE
+};
+
+constexpr size_t CONTENT_ENCODING_COUNT = 3;
+
+// Сжатие тел ответов API. Используется реализация deflate из Boost.Beast,
+// поэтому отдельная библиотека сжатия не нужна
+class ResponseCompressor {
+public:
+    static constexpr int DEFAULT_LEVEL = 6;
+    // Тела меньше порога не сжимаются: выигрыш не окупает затрат на сжатие
+    static constexpr size_t MIN_SIZE = 1024;
+
+    // level от 1 до 9, 0 отключает сжатие
+    explicit ResponseCompressor(int level = DEFAULT_LEVEL);
+
+    // Кодирование ответа по заголовку Accept-Encoding: gzip, затем deflate
+    ContentEncoding Negotiate(std::string_view accept_encoding) const;
+
+    bool ShouldCompress(size_t size) const noexcept {
+        return level_ > 0 && size >= MIN_SIZE;
+    }
+
+    std::string Compress(std::string_view data, ContentEncoding encoding) const;
+
+    static std::string_view GetName(ContentEncoding encoding) noexcept;
+
+private:
+    int level_;
+};
+
+// Размеры тела отправленного ответа до и после сжатия, для журнала
+struct ResponseSizes {
+    uint64_t raw = 0;
+    uint64_t sent = 0;
+};
+
+// Обёртка над send: сжимает JSON-ответы не меньше порога выбранным кодированием
+// и запоминает размеры тела. Ответы с уже заданным Content-Encoding не трогает
+template <typename Send>
+class CompressingSend {
+public:
+    CompressingSend(Send&& send, const ResponseCompressor& compressor, ContentEncoding encoding, std::shared_ptr<ResponseSizes> sizes)
+        : send_(std::forward<Send>(send))
+        , compressor_(&compressor)
+        , encoding_(encoding)
+        , sizes_(std::move(sizes)) {
+    }
+
+    template <typename Body, typename Fields>
+    void operator()(http::response<Body, Fields>& response) {
+        const uint64_t raw = response.payload_size().value_or(0);
+        sizes_->raw = raw;
+        sizes_->sent = raw;
+
+        if constexpr (std::is_same_v<Body, http::string_body> || std::is_same_v<Body, http_server::SharedStringBody>) {
+            if (encoding_ != ContentEncoding::IDENTITY && compressor_->ShouldCompress(raw)
+                && response[http::field::content_type] == MimeType::APP_JSON
+                && response.find(http::field::content_encoding) == response.end()) {
+                http::response<http::string_body> compressed{std::move(response.base())};
+                compressed.body() = compressor_->Compress(GetBody(response), encoding_);
+                compressed.set(http::field::content_encoding, ResponseCompressor::GetName(encoding_));
+                compressed.set(http::field::vary, "Accept-Encoding");
+                compressed.prepare_payload();
+
+                sizes_->sent = compressed.body().size();
+                return send_(compressed);
+            }
+        }
+        send_(response);
+    }
+
+private:
+    static std::string_view GetBody(const http::response<http::string_body>& response) {
+        return response.body();
+    }
+    static std::string_view GetBody(const http::response<http_server::SharedStringBody>& response) {
+        return response.body() ? std::string_view(*response.body()) : std::string_view{};
+    }
+
+    Send send_;
+    const ResponseCompressor* compressor_;
+    ContentEncoding encoding_;
+    std::shared_ptr<ResponseSizes> sizes_;
+};
+
+}  // namespace http_handler
@@ -20,6 +20,143 @@ std::vector<std::string_view> SplitRequest(std::string_view body) {
     return result;
 }
 
+std::optional<std::string_view> GetQueryParam(std::string_view query, std::string_view name) {
+    while (!query.empty()) {
+        const size_t end = query.find('&');
+        const std::string_view param = query.substr(0, end);
+        query = end == std::string_view::npos ? std::string_view{} : query.substr(end + 1);
+
+        const size_t eq = param.find('=');
+        if (param.substr(0, eq) == name)
+            return eq == std::string_view::npos ? std::string_view{} : param.substr(eq + 1);
+    }
+    return std::nullopt;
+}
+
+bool AcceptsMimeType(std::string_view accept, std::string_view type) {
+    while (!accept.empty()) {
+        const size_t end = accept.find(',');
+        std::string_view item = accept.substr(0, end);
+        accept = end == std::string_view::npos ? std::string_view{} : accept.substr(end + 1);
+
+        item = item.substr(0, item.find(';'));
+        while (!item.empty() && item.front() == ' ')
+            item.remove_prefix(1);
+        while (!item.empty() && item.back() == ' ')
+            item.remove_suffix(1);
+
+        if (item == type)
+            return true;
+    }
+    return false;
+}
+
+bool AcceptsEncoding(std::string_view accept_encoding, std::string_view coding) {
+    const auto trim = [](std::string_view str) {
+        while (!str.empty() && str.front() == ' ')
+            str.remove_prefix(1);
+        while (!str.empty() && str.back() == ' ')
+            str.remove_suffix(1);
+        return str;
+    };
+
+    bool accepted = false;
+    while (!accept_encoding.empty()) {
+        const size_t end = accept_encoding.find(',');
+        std::string_view item = accept_encoding.substr(0, end);
+        accept_encoding = end == std::string_view::npos ? std::string_view{} : accept_encoding.substr(end + 1);
+
+        const size_t params = item.find(';');
+        const std::string_view name = trim(item.substr(0, params));
+        if (name != coding && name != "*"sv)
+            continue;
+
+        // q=0, q=0.0, q=0.000 - кодирование запрещено
+        bool forbidden = false;
+        if (params != std::string_view::npos) {
+            std::string_view q = trim(item.substr(params + 1));
+            if (q.starts_with("q=0"sv)) {
+                q.remove_prefix(3);
+                forbidden = q.empty() || (q.front() == '.' && q.find_first_not_of('0', 1) == std::string_view::npos);
+            }
+        }
+
+        // Явно указанное кодирование важнее *
+        if (name == coding)
+            return !forbidden;
+        accepted = !forbidden;
+    }
+    return accepted;
+}
+
+RangeParseResult ParseRange(std::string_view range, uint64_t size, std::vector<ByteRange>& ranges) {
+    // Больше диапазонов не обслуживается: ответ из множества мелких частей дороже целого файла
+    constexpr size_t MAX_RANGES = 16;
+
+    const auto trim = [](std::string_view str) {
+        while (!str.empty() && str.front() == ' ')
+            str.remove_prefix(1);
+        while (!str.empty() && str.back() == ' ')
+            str.remove_suffix(1);
+        return str;
+    };
+    const auto parse_number = [](std::string_view str, uint64_t& value) {
+        const auto [end, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+        return !str.empty() && ec == std::errc{} && end == str.data() + str.size();
+    };
+
+    ranges.clear();
+    if (!range.starts_with("bytes="sv))
+        return RangeParseResult::NONE;
+    range.remove_prefix(6);
+
+    size_t count = 0;
+    while (!range.empty()) {
+        const size_t end = range.find(',');
+        const std::string_view item = trim(range.substr(0, end));
+        range = end == std::string_view::npos ? std::string_view{} : range.substr(end + 1);
+        if (item.empty())
+            continue;
+        if (++count > MAX_RANGES)
+            return RangeParseResult::NONE;
+
+        const size_t dash = item.find('-');
+        if (dash == std::string_view::npos)
+            return RangeParseResult::NONE;
+
+        const std::string_view first = item.substr(0, dash);
+        const std::string_view last = item.substr(dash + 1);
+        ByteRange byte_range;
+
+        if (first.empty()) {
+            // -N: последние N байт
+            uint64_t suffix = 0;
+            if (!parse_number(last, suffix))
+                return RangeParseResult::NONE;
+            if (suffix == 0 || size == 0)
+                continue;
+            byte_range = { size > suffix ? size - suffix : 0, size - 1 };
+        } else {
+            if (!parse_number(first, byte_range.first))
+                return RangeParseResult::NONE;
+            byte_range.last = size == 0 ? 0 : size - 1;
+            if (!last.empty()) {
+                uint64_t value = 0;
+                if (!parse_number(last, value) || value < byte_range.first)
+                    return RangeParseResult::NONE;
+                byte_range.last = std::min(byte_range.last, value);
+            }
+            if (byte_range.first >= size)
+                continue;
+        }
+        ranges.push_back(byte_range);
+    }
+
+    if (count == 0)
+        return RangeParseResult::NONE;
+    return ranges.empty() ? RangeParseResult::UNSATISFIABLE : RangeParseResult::SATISFIABLE;
+}
+
 json::object MapToJson(const model::Map* map) {
     json::object obj;
     obj[std::string(model::ModelLiterals::ID)] = *map->GetId();
@@ -71,6 +208,18 @@ json::array BuildingsToJson(const model::Map* map) {
     return buildings;
 }
 
+json::value TickStatsToJson(const app::TickStats& stats) {
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+    const auto count = static_cast<int64_t>(stats.count);
+    return {
+        {"ticks", stats.count},
+        {"last_us", duration_cast<microseconds>(stats.last).count()},
+        {"max_us", duration_cast<microseconds>(stats.max).count()},
+        {"avg_us", count > 0 ? duration_cast<microseconds>(stats.total).count() / count : 0}
+    };
+}
+
 std::string_view GetMimeType(std::string_view extension) {
 
     static const std::unordered_map<std::string_view, std::string_view> mime_types = {
@@ -1,6 +1,8 @@
 #pragma once
 
+#include "api_router.h"
 #include "http_server.h"
+#include "json_arena.h"
 #include "model.h"
 #include "player_models.h"
 
@@ -13,9 +15,11 @@
 #include <boost/log/utility/setup/console.hpp>
 #include <boost/date_time.hpp>
 #include <boost/chrono.hpp>
+#include <charconv>
 #include <filesystem>
 #include <functional>
 #include <memory>
+#include <optional>
 #include <string_view>
 
 namespace http_handler {
@@ -41,23 +45,13 @@ struct MimeType {
     constexpr static std::string_view TIFF = "image/tiff"sv;
     constexpr static std::string_view SVG = "image/svg+xml"sv;
     constexpr static std::string_view MP3 = "audio/mpeg"sv;
+    // Двоичное состояние игры, см. binary_state.h
+    constexpr static std::string_view GAME_STATE = "application/x-game-state"sv;
+    // Текстовый формат метрик Prometheus
+    constexpr static std::string_view PROMETHEUS_TEXT = "text/plain; version=0.0.4"sv;
     constexpr static std::string_view UNKNOWN = "application/octet-stream"sv;
 };
 
-struct RestApiLiteral {
-    RestApiLiteral() = delete;
-    constexpr static std::string_view API_V1 = "/api/v1/"sv;
-    constexpr static std::string_view MAPS = "maps"sv;
-    constexpr static std::string_view MAP = "map"sv;
-    constexpr static std::string_view GAME = "game"sv;
-    constexpr static std::string_view JOIN = "join"sv;
-    constexpr static std::string_view PLAYERS = "players"sv;
-    constexpr static std::string_view STATE = "state"sv;
-    constexpr static std::string_view PLAYER = "player"sv;
-    constexpr static std::string_view ACTION = "action"sv;
-    constexpr static std::string_view TICK = "tick"sv;
-};
-
 struct RequestHttpBody {
     RequestHttpBody() = delete;
     constexpr static std::string_view BAD_REQUEST = R"({ "code": "badRequest", "message": "Bad request" })"sv;
@@ -66,19 +60,46 @@ struct RequestHttpBody {
     constexpr static std::string_view INVALID_NAME = R"({ "code": "invalidArgument", "message": "Invalid name" })"sv;
     constexpr static std::string_view JOIN_GAME_PARSE_ERROR = R"({ "code": "invalidArgument", "message": "Join game request parse error" })"sv;
     constexpr static std::string_view ACTION_PARSE_ERROR = R"({ "code": "invalidArgument", "message": "Failed to parse action" })"sv;
+    constexpr static std::string_view ACTIONS_SESSION_MISMATCH = R"({ "code": "invalidArgument", "message": "All players in a batch must share one game session" })"sv;
     constexpr static std::string_view TICK_PARSE_ERROR = R"({ "code": "invalidArgument", "message": "Failed to parse tick request JSON" })"sv;
     constexpr static std::string_view METHOD_NOT_ALLOWED = R"({ "code": "invalidMethod", "message": "Another method expected" })"sv;
     constexpr static std::string_view INVALID_TOKEN = R"({ "code": "invalidToken", "message": "Authorization header is missing" })"sv;
     constexpr static std::string_view TOKEN_UNKNOWN = R"({ "code": "unknownToken", "message": "Player token has not been found" })"sv;
+    constexpr static std::string_view INVALID_SINCE = R"({ "code": "invalidArgument", "message": "Failed to parse since parameter" })"sv;
     constexpr static std::string_view INVALID_CONTENT_TYPE = R"({"code": "invalidArgument", "message": "Invalid content type"} )"sv;
 };
 
+// Диапазон байтов из заголовка Range, границы включительно
+struct ByteRange {
+    uint64_t first = 0;
+    uint64_t last = 0;
+};
+
+enum class RangeParseResult {
+    // Заголовка нет, он некорректен или диапазонов слишком много: отправляется весь ресурс
+    NONE,
+    SATISFIABLE,
+    // Ни один диапазон не пересекается с ресурсом: ответ 416
+    UNSATISFIABLE
+};
+
 namespace utils {
 	std::vector<std::string_view> SplitRequest(std::string_view body);
+	// Значение параметра name из строки запроса вида "a=1&b=2"
+	std::optional<std::string_view> GetQueryParam(std::string_view query, std::string_view name);
+	// Перечислен ли type в значении заголовка Accept (параметры вида ;q= не учитываются)
+	bool AcceptsMimeType(std::string_view accept, std::string_view type);
+	// Допускает ли заголовок Accept-Encoding кодирование coding. Вариант с q=0 запрещён
+	bool AcceptsEncoding(std::string_view accept_encoding, std::string_view coding);
+	// Разбирает заголовок Range вида bytes=0-99,200-,-50 для ресурса размера size.
+	// В ranges попадают только диапазоны, пересекающиеся с ресурсом, в порядке из заголовка
+	RangeParseResult ParseRange(std::string_view range, uint64_t size, std::vector<ByteRange>& ranges);
 	json::object MapToJson(const model::Map* map);
 	json::array RoadsToJson(const model::Map* map);
 	json::array OfficesToJson(const model::Map* map);
 	json::array BuildingsToJson(const model::Map* map);
+	// Сводка длительности тиков для журнала: число тиков, последний, наибольший и средний в мкс
+	json::value TickStatsToJson(const app::TickStats& stats);
 
     std::string_view GetMimeType(std::string_view extension);
 }
@@ -86,6 +107,9 @@ namespace utils {
 struct ResponseData {
     http::status code;
     std::string_view content_type;
+    // Размер отправленного тела и размер до сжатия
+    uint64_t body_bytes = 0;
+    uint64_t raw_bytes = 0;
 };
 
 }
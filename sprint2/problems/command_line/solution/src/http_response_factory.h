@@ -1,6 +1,13 @@
 #pragma once
 
 #include "handler_utils.h"
+#include "range_body.h"
+#include "response_cache.h"
+#include "shared_body.h"
+#include "static_cache.h"
+
+#include <cstdio>
+#include <random>
 
 namespace http_handler {
 
@@ -26,39 +33,76 @@ public:
         return { http::status::bad_request, MimeType::APP_JSON };
     }
 
+    // Отправляет файл из кеша статического контента. Если ETag совпадает с If-None-Match,
+    // отправляется 304 без тела. Заголовок Range обслуживается ответом 206 с одним фрагментом
+    // или multipart/byteranges (если есть If-Range, то только при совпадении с ETag).
+    // Иначе отправляется весь файл, сжатым вариантом (br или gzip), если клиент его принимает.
+    // У сжатых вариантов свой ETag, диапазоны всегда берутся из несжатого файла
     template<typename Send>
-    static ResponseData HandleFileResponseOr404(const fs::path root_path, std::string_view path, Send&& send, bool is_head_method = false) {
-        http::response<http::file_body> res;
-        res.version(11);
-        res.result(http::status::ok);
+    static ResponseData HandleStaticFile(const StaticFile& file, const StaticFileRequest& request, Send&& send) {
+        const bool has_variants = file.gzip || file.brotli;
 
-        std::string full_path = root_path.string() + path.data();
-        std::string_view type = MimeType::TEXT_HTML;
+        std::vector<ByteRange> ranges;
+        auto range_result = RangeParseResult::NONE;
+        if (!request.range.empty() && (request.if_range.empty() || request.if_range == file.etag))
+            range_result = utils::ParseRange(request.range, file.GetSize(), ranges);
 
-        std::size_t ext_pos = path.find_last_of('.');
-        if (ext_pos != std::string_view::npos) {
-            type = utils::GetMimeType(path.substr(ext_pos + 1));
-        } else {
-            full_path = root_path.string() + "/index.html";
+        StaticFile::Body body = file.body;
+        std::string_view encoding;
+        std::string_view etag = file.etag;
+        if (range_result == RangeParseResult::NONE && file.body) {
+            if (file.brotli && utils::AcceptsEncoding(request.accept_encoding, "br"sv)) {
+                body = file.brotli;
+                encoding = "br"sv;
+                etag = file.brotli_etag;
+            } else if (file.gzip && utils::AcceptsEncoding(request.accept_encoding, "gzip"sv)) {
+                body = file.gzip;
+                encoding = "gzip"sv;
+                etag = file.gzip_etag;
+            }
         }
 
-        res.set(http::field::content_type, type);
+        if (!request.if_none_match.empty() && MatchesETag(request.if_none_match, etag)) {
+            http::response<http::empty_body> response(http::status::not_modified, 11);
+            response.insert(http::field::cache_control, "no-cache");
+            response.insert(http::field::etag, etag);
+            if (has_variants)
+                response.insert(http::field::vary, "Accept-Encoding");
+            send(response);
+            return { http::status::not_modified, file.content_type };
+        }
 
-        http::file_body::value_type file;
-        sys::error_code ec;
-        file.open(full_path.c_str(), beast::file_mode::read, ec);
+        if (range_result == RangeParseResult::SATISFIABLE)
+            return HandleFileRanges(file, ranges, std::forward<Send>(send), request.is_head_method);
+        if (range_result == RangeParseResult::UNSATISFIABLE)
+            return HandleRangeNotSatisfiable(file, std::forward<Send>(send));
 
-        if (ec) {
-            HandleResponse(http::status::not_found, RequestHttpBody::FILE_NOT_FOUND, std::forward<Send>(send), MimeType::TEXT_PLAIN, is_head_method);
-            return { http::status::not_found, MimeType::TEXT_PLAIN };
-        }
+        if (!file.body)
+            return HandleLargeFile(file, std::forward<Send>(send), request.is_head_method);
 
-        if (!is_head_method)
-            res.body() = std::move(file);
+        http::response<http_server::SharedStringBody> response(http::status::ok, 11);
+        response.insert(http::field::content_type, file.content_type);
+        response.insert(http::field::cache_control, "no-cache");
+        response.insert(http::field::etag, etag);
+        response.insert(http::field::last_modified, file.last_modified);
+        response.insert(http::field::accept_ranges, "bytes");
+        if (!encoding.empty())
+            response.insert(http::field::content_encoding, encoding);
+        if (has_variants)
+            response.insert(http::field::vary, "Accept-Encoding");
+        response.content_length(http_server::SharedStringBody::size(body));
+
+        if (!request.is_head_method)
+            response.body() = std::move(body);
+
+        send(response);
+        return { http::status::ok, file.content_type };
+    }
 
-        res.prepare_payload();
-        send(res);
-        return { http::status::ok, type };
+    template<typename Send>
+    static ResponseData HandleFileNotFound(Send&& send, bool is_head_method = false) {
+        HandleResponse(http::status::not_found, RequestHttpBody::FILE_NOT_FOUND, std::forward<Send>(send), MimeType::TEXT_PLAIN, is_head_method);
+        return { http::status::not_found, MimeType::TEXT_PLAIN };
     }
 
     template<typename Send>
@@ -70,6 +114,8 @@ public:
 
         if (!is_head_method)
             response.body() = body;
+
+        response.prepare_payload();
         send(response);
     }
 
@@ -87,6 +133,65 @@ public:
         send(response);
     }
 
+    // Отправляет заранее сериализованный ответ без копирования тела, сжатым вариантом,
+    // если он есть для encoding. Если ETag варианта совпадает с If-None-Match, отправляется 304 без тела
+    template<typename Send>
+    static ResponseData HandleCachedResponse(const CachedResponse& cached, std::string_view if_none_match, Send&& send,
+                                             bool is_head_method = false, ContentEncoding encoding = ContentEncoding::IDENTITY) {
+        const std::string_view body = cached.GetBody(encoding);
+        const std::string_view etag = cached.GetETag(encoding);
+
+        if (!if_none_match.empty() && MatchesETag(if_none_match, etag)) {
+            http::response<http::empty_body> response(http::status::not_modified, 11);
+            response.insert(http::field::cache_control, "no-cache");
+            response.insert(http::field::etag, etag);
+            if (!cached.gzip.empty())
+                response.insert(http::field::vary, "Accept-Encoding");
+            send(response);
+            return { http::status::not_modified, MimeType::APP_JSON };
+        }
+
+        http::response<http::span_body<const char>> response(http::status::ok, 11);
+
+        response.insert(http::field::content_type, MimeType::APP_JSON);
+        response.insert(http::field::cache_control, "no-cache");
+        response.insert(http::field::etag, etag);
+        if (encoding != ContentEncoding::IDENTITY)
+            response.insert(http::field::content_encoding, ResponseCompressor::GetName(encoding));
+        if (!cached.gzip.empty())
+            response.insert(http::field::vary, "Accept-Encoding");
+        response.content_length(body.size());
+
+        if (!is_head_method)
+            response.body() = { body.data(), body.size() };
+
+        send(response);
+        return { http::status::ok, MimeType::APP_JSON, 0, cached.body.size() };
+    }
+
+    // Отправляет тело, разделяемое с кешем и другими ответами. Тело, заранее сжатое кодированием
+    // encoding, отправляется с Content-Encoding, raw_size - его несжатый размер для журнала
+    template<typename Send>
+    static ResponseData HandleSharedResponse(http::status status, http_server::SharedStringBody::value_type body, Send&& send,
+                                             std::string_view type = MimeType::APP_JSON, bool is_head_method = false,
+                                             ContentEncoding encoding = ContentEncoding::IDENTITY, uint64_t raw_size = 0) {
+        http::response<http_server::SharedStringBody> response(status, 11);
+
+        response.insert(http::field::content_type, type);
+        response.insert(http::field::cache_control, "no-cache");
+        if (encoding != ContentEncoding::IDENTITY) {
+            response.insert(http::field::content_encoding, ResponseCompressor::GetName(encoding));
+            response.insert(http::field::vary, "Accept-Encoding");
+        }
+        response.content_length(http_server::SharedStringBody::size(body));
+
+        if (!is_head_method)
+            response.body() = std::move(body);
+
+        send(response);
+        return { status, type, 0, raw_size };
+    }
+
     template<typename Send>
     static ResponseData HandleMethodNotAllowed(Send&& send, std::string_view allow) {
         http::response<http::string_body> response(http::status::method_not_allowed, 11);
@@ -99,6 +204,104 @@ public:
         send(response);
         return { http::status::method_not_allowed, MimeType::APP_JSON };
     }
+
+private:
+    // Граница multipart/byteranges из 128 случайных бит: содержимое файла с ней совпадёт
+    // лишь с пренебрежимо малой вероятностью
+    static std::string MakeBoundary() {
+        thread_local std::mt19937_64 generator{std::random_device{}()};
+        char buffer[48];
+        const int size = std::snprintf(buffer, sizeof(buffer), "range-%016llx%016llx",
+                                       static_cast<unsigned long long>(generator()),
+                                       static_cast<unsigned long long>(generator()));
+        return std::string(buffer, static_cast<size_t>(size));
+    }
+
+    static std::string FormatContentRange(const ByteRange& range, uint64_t size) {
+        return "bytes "s + std::to_string(range.first) + '-' + std::to_string(range.last) + '/' + std::to_string(size);
+    }
+
+    // Ответ 206. Фрагменты файлов, которых нет в памяти, читаются с диска при отправке
+    template<typename Send>
+    static ResponseData HandleFileRanges(const StaticFile& file, const std::vector<ByteRange>& ranges, Send&& send, bool is_head_method) {
+        http_server::RangeBody::value_type body;
+        if (file.body) {
+            body.content = file.body;
+        } else if (!is_head_method) {
+            sys::error_code ec;
+            body.file.open(file.path.c_str(), beast::file_mode::read, ec);
+            if (ec)
+                return HandleFileNotFound(std::forward<Send>(send));
+        }
+
+        http::response<http_server::RangeBody> response(http::status::partial_content, 11);
+        response.insert(http::field::cache_control, "no-cache");
+        response.insert(http::field::etag, file.etag);
+        response.insert(http::field::last_modified, file.last_modified);
+        response.insert(http::field::accept_ranges, "bytes");
+
+        if (ranges.size() == 1) {
+            const auto& range = ranges.front();
+            response.insert(http::field::content_type, file.content_type);
+            response.insert(http::field::content_range, FormatContentRange(range, file.GetSize()));
+            body.parts.push_back({ {}, range.first, range.last - range.first + 1 });
+        } else {
+            const std::string boundary = MakeBoundary();
+            response.insert(http::field::content_type, "multipart/byteranges; boundary=" + boundary);
+
+            for (const auto& range : ranges) {
+                std::string prefix = body.parts.empty() ? ""s : "\r\n"s;
+                prefix += "--" + boundary + "\r\nContent-Type: " + std::string(file.content_type)
+                    + "\r\nContent-Range: " + FormatContentRange(range, file.GetSize()) + "\r\n\r\n";
+                body.parts.push_back({ std::move(prefix), range.first, range.last - range.first + 1 });
+            }
+            body.suffix = "\r\n--" + boundary + "--\r\n";
+        }
+        response.content_length(http_server::RangeBody::size(body));
+
+        if (!is_head_method)
+            response.body() = std::move(body);
+
+        send(response);
+        return { http::status::partial_content, file.content_type };
+    }
+
+    template<typename Send>
+    static ResponseData HandleRangeNotSatisfiable(const StaticFile& file, Send&& send) {
+        http::response<http::empty_body> response(http::status::range_not_satisfiable, 11);
+        response.insert(http::field::cache_control, "no-cache");
+        response.insert(http::field::content_range, "bytes */" + std::to_string(file.GetSize()));
+        response.insert(http::field::accept_ranges, "bytes");
+        response.content_length(0);
+        send(response);
+        return { http::status::range_not_satisfiable, file.content_type };
+    }
+
+    // Большие файлы не хранятся в памяти: file_body читает их с диска частями при отправке
+    template<typename Send>
+    static ResponseData HandleLargeFile(const StaticFile& file, Send&& send, bool is_head_method) {
+        http::response<http::file_body> response(http::status::ok, 11);
+        response.insert(http::field::content_type, file.content_type);
+        response.insert(http::field::cache_control, "no-cache");
+        response.insert(http::field::etag, file.etag);
+        response.insert(http::field::last_modified, file.last_modified);
+        response.insert(http::field::accept_ranges, "bytes");
+
+        if (is_head_method) {
+            response.content_length(file.size);
+            send(response);
+            return { http::status::ok, file.content_type };
+        }
+
+        sys::error_code ec;
+        response.body().open(file.path.c_str(), beast::file_mode::scan, ec);
+        if (ec)
+            return HandleFileNotFound(std::forward<Send>(send));
+
+        response.prepare_payload();
+        send(response);
+        return { http::status::ok, file.content_type };
+    }
 };
 
 }
\ No newline at end of file
@@ -17,6 +17,57 @@ void ReportError(beast::error_code ec, std::string_view where) {
     BOOST_LOG_TRIVIAL(error) << boost::log::add_value(error_data, data) << "error";
 }
 
+namespace {
+
+std::atomic<size_t> active_sessions{0};
+std::atomic<uint64_t> accepted_sessions{0};
+std::atomic<uint64_t> rejected_sessions{0};
+
+constexpr std::string_view SERVICE_UNAVAILABLE =
+    "HTTP/1.1 503 Service Unavailable\r\n"
+    "Content-Type: text/plain\r\n"
+    "Content-Length: 19\r\n"
+    "Retry-After: 1\r\n"
+    "Connection: close\r\n"
+    "\r\n"
+    "Service Unavailable"sv;
+
+}  // namespace
+
+ConnectionSlot::ConnectionSlot() noexcept {
+    active_sessions.fetch_add(1, std::memory_order_relaxed);
+    accepted_sessions.fetch_add(1, std::memory_order_relaxed);
+}
+
+ConnectionSlot::~ConnectionSlot() {
+    if (active_)
+        active_sessions.fetch_sub(1, std::memory_order_relaxed);
+}
+
+size_t ConnectionSlot::GetActiveCount() noexcept {
+    return active_sessions.load(std::memory_order_relaxed);
+}
+
+ServerStats GetServerStats() noexcept {
+    return {
+        accepted_sessions.load(std::memory_order_relaxed),
+        rejected_sessions.load(std::memory_order_relaxed),
+        active_sessions.load(std::memory_order_relaxed),
+        BufferPool::GetStats()
+    };
+}
+
+void RejectConnection(tcp::socket&& socket) {
+    rejected_sessions.fetch_add(1, std::memory_order_relaxed);
+
+    auto stream = std::make_shared<tcp::socket>(std::move(socket));
+    net::async_write(*stream, net::buffer(SERVICE_UNAVAILABLE.data(), SERVICE_UNAVAILABLE.size()),
+        [stream](sys::error_code, std::size_t) {
+            sys::error_code ignored;
+            stream->shutdown(tcp::socket::shutdown_both, ignored);
+        });
+}
+
 void SessionBase::Run() {
     // Вызываем метод Read, используя executor объекта stream_.
     // Таким образом вся работа со stream_ будет выполняться, используя его executor
@@ -24,4 +75,82 @@ void SessionBase::Run() {
         beast::bind_front_handler(&SessionBase::Read, GetSharedThis()));
 }
 
+void WebSocketSession::Reject(http::status status, std::string_view body, std::string_view content_type) {
+    auto response = std::make_shared<http::response<http::string_body>>(status, 11);
+    response->set(http::field::content_type, content_type);
+    response->set(http::field::cache_control, "no-cache");
+    response->keep_alive(false);
+    response->body() = body;
+    response->prepare_payload();
+
+    net::dispatch(ws_.get_executor(), [self = shared_from_this(), response] {
+        http::async_write(self->ws_.next_layer(), *response,
+            [self, response](beast::error_code ec, std::size_t) {
+                if (ec)
+                    ReportError(ec, "write"sv);
+                beast::error_code ignored;
+                self->ws_.next_layer().socket().shutdown(tcp::socket::shutdown_send, ignored);
+            });
+    });
+}
+
+void WebSocketSession::Send(Frame frame) {
+    net::dispatch(ws_.get_executor(), [self = shared_from_this(), frame = std::move(frame)]() mutable {
+        if (!self->IsOpen())
+            return;
+        self->pending_ = std::move(frame);
+        if (!self->writing_)
+            self->DoWrite();
+    });
+}
+
+void WebSocketSession::OnAccept(beast::error_code ec, Frame first_frame) {
+    if (ec)
+        return ReportError(ec, "websocket accept"sv);
+
+    open_.store(true, std::memory_order_release);
+    DoRead();
+
+    if (first_frame && !pending_) {
+        pending_ = std::move(first_frame);
+        if (!writing_)
+            DoWrite();
+    }
+}
+
+void WebSocketSession::DoRead() {
+    // Чтение нужно, чтобы обрабатывать ping/pong и закрытие соединения клиентом
+    ws_.async_read(buffer_, [self = shared_from_this()](beast::error_code ec, std::size_t) {
+        self->OnRead(ec);
+    });
+}
+
+void WebSocketSession::OnRead(beast::error_code ec) {
+    if (ec) {
+        open_.store(false, std::memory_order_release);
+        if (ec != websocket::error::closed)
+            ReportError(ec, "websocket read"sv);
+        return;
+    }
+    buffer_.clear();
+    DoRead();
+}
+
+void WebSocketSession::DoWrite() {
+    writing_ = std::move(pending_);
+    ws_.async_write(net::buffer(*writing_), [self = shared_from_this()](beast::error_code ec, std::size_t) {
+        self->OnWrite(ec);
+    });
+}
+
+void WebSocketSession::OnWrite(beast::error_code ec) {
+    writing_.reset();
+    if (ec) {
+        open_.store(false, std::memory_order_release);
+        return ReportError(ec, "websocket write"sv);
+    }
+    if (pending_)
+        DoWrite();
+}
+
 }  // namespace http_server
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
 #include "sdk.h"
+#include "buffer_pool.h"
+#include "tracer.h"
 // boost.beast будет использовать std::string_view вместо boost::string_view
 #define BOOST_BEAST_USE_STD_STRING_VIEW
 
@@ -7,6 +9,17 @@
 #include <boost/asio/strand.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
+#include <boost/beast/websocket.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
 
 namespace http_server {
 
@@ -14,12 +27,163 @@ namespace http_server {
     using tcp = net::ip::tcp;
     namespace beast = boost::beast;
     namespace http = beast::http;
+    namespace websocket = beast::websocket;
     namespace sys = boost::system;
 
     using namespace std::literals;
 
     void ReportError(beast::error_code ec, std::string_view where);
 
+    // Ограничение числа одновременных HTTP-сессий по умолчанию. Сверх него Listener
+    // отвечает на новые соединения 503 и закрывает их, не создавая сессию
+    constexpr size_t DEFAULT_MAX_SESSIONS = 10000;
+
+    struct ListenerOptions {
+        size_t max_sessions = DEFAULT_MAX_SESSIONS;
+        // SO_REUSEPORT: несколько acceptor на одном порту, ядро распределяет между ними
+        // входящие соединения. Используется, когда у каждого потока свой io_context
+        bool reuse_port = false;
+    };
+
+#ifdef SO_REUSEPORT
+    // Опция сокета SO_REUSEPORT для acceptor.set_option. В asio такой опции нет, поэтому
+    // она описана по требованиям SettableSocketOption: level, name, data и size
+    class ReusePort {
+    public:
+        explicit ReusePort(bool enabled) noexcept
+            : value_(enabled ? 1 : 0) {
+        }
+
+        template <typename Protocol>
+        int level(const Protocol&) const noexcept { return SOL_SOCKET; }
+        template <typename Protocol>
+        int name(const Protocol&) const noexcept { return SO_REUSEPORT; }
+        template <typename Protocol>
+        const void* data(const Protocol&) const noexcept { return &value_; }
+        template <typename Protocol>
+        std::size_t size(const Protocol&) const noexcept { return sizeof(value_); }
+
+    private:
+        int value_;
+    };
+#endif
+
+    // Статистика соединений всех Listener сервера и пула буферов
+    struct ServerStats {
+        uint64_t accepted = 0;
+        uint64_t rejected = 0;
+        size_t active = 0;
+        BufferPool::Stats pool;
+    };
+
+    ServerStats GetServerStats() noexcept;
+
+    // Время прохождения запроса через сессию по монотонным часам: от окончания чтения
+    // запроса до окончания записи ответа, с учётом очередей и ожидания предыдущих ответов
+    struct RequestTiming {
+        using Clock = std::chrono::steady_clock;
+
+        Clock::time_point read_done;
+        Clock::time_point write_done;
+    };
+
+    // Вызывается, когда ответ записан в сокет или запись завершилась ошибкой
+    using WrittenHandler = std::function<void(const RequestTiming&)>;
+
+    // Учитывает соединение в числе активных на время его жизни. При переключении на WebSocket
+    // место передаётся WebSocketSession, поэтому подписчики тоже ограничены max_sessions
+    class ConnectionSlot {
+    public:
+        ConnectionSlot() noexcept;
+        ~ConnectionSlot();
+
+        ConnectionSlot(ConnectionSlot&& other) noexcept
+            : active_(std::exchange(other.active_, false)) {
+        }
+        ConnectionSlot(const ConnectionSlot&) = delete;
+        ConnectionSlot& operator=(const ConnectionSlot&) = delete;
+
+        static size_t GetActiveCount() noexcept;
+
+    private:
+        bool active_ = true;
+    };
+
+    // Отвечает 503 и закрывает соединение, для которого не нашлось места
+    void RejectConnection(tcp::socket&& socket);
+
+    // Соединение, переключённое на протокол WebSocket.
+    // Используется только для отправки сообщений сервером, входящие сообщения игнорируются
+    class WebSocketSession : public std::enable_shared_from_this<WebSocketSession> {
+    public:
+        using Frame = std::shared_ptr<const std::string>;
+
+        WebSocketSession(beast::tcp_stream&& stream, ConnectionSlot&& slot)
+            : slot_(std::move(slot))
+            , ws_(std::move(stream)) {
+        }
+
+        WebSocketSession(const WebSocketSession&) = delete;
+        WebSocketSession& operator=(const WebSocketSession&) = delete;
+
+        // Завершает handshake. Первое сообщение first_frame (если задано) отправляется сразу после него.
+        // Непустой protocol возвращается клиенту в Sec-WebSocket-Protocol. Можно вызывать из любого потока
+        template <typename Body, typename Allocator>
+        void Accept(http::request<Body, http::basic_fields<Allocator>>&& request, Frame first_frame = nullptr,
+                    std::string_view protocol = {}) {
+            net::dispatch(ws_.get_executor(), [self = shared_from_this(), request = std::move(request),
+                                               first_frame = std::move(first_frame), protocol]() mutable {
+                self->DoAccept(std::move(request), std::move(first_frame), protocol);
+            });
+        }
+
+        // Отклоняет запрос на переключение протокола обычным HTTP-ответом
+        void Reject(http::status status, std::string_view body, std::string_view content_type);
+
+        // Ставит сообщение в очередь отправки. Можно вызывать из любого потока.
+        // Сообщения содержат полное состояние, поэтому медленному клиенту отправляется
+        // только последнее из накопившихся
+        void Send(Frame frame);
+
+        bool IsOpen() const noexcept { return open_.load(std::memory_order_acquire); }
+
+    private:
+        ConnectionSlot slot_;
+        websocket::stream<beast::tcp_stream> ws_;
+        beast::flat_buffer buffer_;
+        Frame writing_;
+        Frame pending_;
+        std::atomic<bool> open_{false};
+
+        template <typename Request>
+        void DoAccept(Request&& request, Frame first_frame, std::string_view protocol) {
+            // После handshake действуют таймауты WebSocket, а не HTTP-сессии
+            beast::get_lowest_layer(ws_).expires_never();
+            ws_.set_option(websocket::stream_base::timeout::suggested(beast::role_type::server));
+            ws_.text(true);
+            if (!protocol.empty()) {
+                ws_.set_option(websocket::stream_base::decorator([protocol](websocket::response_type& res) {
+                    res.set(http::field::sec_websocket_protocol, protocol);
+                }));
+            }
+
+            auto req = std::make_shared<std::decay_t<Request>>(std::forward<Request>(request));
+            ws_.async_accept(*req, [self = shared_from_this(), req, first_frame = std::move(first_frame)](beast::error_code ec) mutable {
+                self->OnAccept(ec, std::move(first_frame));
+            });
+        }
+
+        void OnAccept(beast::error_code ec, Frame first_frame);
+        void DoRead();
+        void OnRead(beast::error_code ec);
+        void DoWrite();
+        void OnWrite(beast::error_code ec);
+    };
+
+    // HTTP-сессия с поддержкой конвейерной обработки (HTTP/1.1 pipelining): следующий запрос
+    // читается, пока предыдущие ещё обрабатываются и отправляются. Запросы одного соединения
+    // могут выполняться параллельно в разных strand, а ответы отправляются строго в порядке
+    // поступления запросов. Вся работа с очередью выполняется в executor потока stream_
     class SessionBase {
     public:
         // Запрещаем копирование и присваивание объектов SessionBase и его наследников
@@ -32,33 +196,137 @@ namespace http_server {
         beast::net::ip::address address_;
         using HttpRequest = http::request<http::string_body>;
 
+        // Число запросов соединения, ответы на которые ещё не отправлены.
+        // Дойдя до него, сессия перестаёт читать новые запросы
+        static constexpr size_t MAX_PIPELINED_REQUESTS = 16;
+        // Объём тел ответов в очереди отправки, при котором сессия перестаёт читать запросы
+        static constexpr size_t MAX_QUEUED_BYTES = 4 * 1024 * 1024;
+        // Предельный размер буфера чтения. Запрос, который в него не помещается, закрывает соединение
+        static constexpr size_t MAX_READ_BUFFER = 256 * 1024;
+        // Буфер чтения такой ёмкости остаётся у соединения между запросами: в него помещаются
+        // обычные запросы, и каждое чтение не перевыделяет память
+        static constexpr size_t KEPT_READ_BUFFER = 4 * 1024;
+
         ~SessionBase() = default;
 
         explicit SessionBase(tcp::socket&& socket)
             : address_(socket.remote_endpoint().address())
-            , stream_(std::move(socket)) {
+            , stream_(std::move(socket))
+            , buffer_(MAX_READ_BUFFER) {
+        }
+
+        // Передаёт TCP-поток наружу (например, для WebSocket). После этого сессия не используется
+        beast::tcp_stream ReleaseStream() {
+            return std::move(stream_);
+        }
+
+        // Передаёт место соединения новому владельцу потока
+        ConnectionSlot ReleaseSlot() noexcept {
+            return std::move(slot_);
         }
 
+        // Ответ на запрос с номером index. Можно вызывать из любого потока:
+        // ответ ставится в очередь и отправляется, когда будут отправлены ответы на предыдущие запросы
         template <typename Body, typename Fields>
-        void Write(http::response<Body, Fields>&& response) {
-            // Запись выполняется асинхронно, поэтому response перемещаем в область кучи
-            auto safe_response = std::make_shared<http::response<Body, Fields>>(std::move(response));
-
-            auto self = GetSharedThis();
-            http::async_write(stream_, *safe_response,
-                [safe_response, self](beast::error_code ec, std::size_t bytes_written) {
-                    self->OnWrite(safe_response->need_eof(), ec, bytes_written);
-                });
+        void Write(size_t index, http::response<Body, Fields>&& response, WrittenHandler on_written = {}) {
+            if (const auto& trace = Tracer::Current())
+                trace->Mark(TraceStage::RESPONSE);
+
+            // Запись выполняется асинхронно, поэтому response перемещаем в блок из пула
+            std::unique_ptr<PendingResponse> pending = std::make_unique<PendingResponseImpl<Body, Fields>>(std::move(response));
+            pending->on_written = std::move(on_written);
+
+            net::dispatch(stream_.get_executor(), [self = GetSharedThis(), index, pending = std::move(pending)]() mutable {
+                self->OnResponseReady(index, std::move(pending));
+            });
         }
 
     private:
+        // Ответ в очереди отправки. Стирает тип тела, чтобы ответы разных типов хранились вместе.
+        // Память под ответы берётся из BufferPool
+        struct PendingResponse {
+            using Handler = std::function<void(bool close, beast::error_code ec)>;
+
+            explicit PendingResponse(size_t size) noexcept
+                : size(size) {
+            }
+            virtual ~PendingResponse() = default;
+            virtual void AsyncWrite(beast::tcp_stream& stream, Handler handler) = 0;
+
+            static void* operator new(size_t count) {
+                return BufferPool::Allocate(count);
+            }
+            static void operator delete(void* ptr, size_t count) noexcept {
+                BufferPool::Deallocate(ptr, count);
+            }
+
+            // Размер тела, учитывается в ограничении MAX_QUEUED_BYTES
+            const size_t size;
+            WrittenHandler on_written;
+        };
+
+        template <typename Body, typename Fields>
+        struct PendingResponseImpl : PendingResponse {
+            explicit PendingResponseImpl(http::response<Body, Fields>&& response)
+                : PendingResponse(response.payload_size().value_or(0))
+                , response(std::move(response)) {
+            }
+
+            void AsyncWrite(beast::tcp_stream& stream, Handler handler) override {
+                http::async_write(stream, response, [this, handler = std::move(handler)](beast::error_code ec, std::size_t) {
+                    handler(response.need_eof(), ec);
+                });
+            }
+
+            http::response<Body, Fields> response;
+        };
+
+        ConnectionSlot slot_;
         // tcp_stream содержит внутри себя сокет и добавляет поддержку таймаутов
         beast::tcp_stream stream_;
-        beast::flat_buffer buffer_;
+        // Память буфера берётся из пула и возвращается в него, пока соединение простаивает
+        beast::basic_flat_buffer<PoolAllocator<char>> buffer_;
         HttpRequest request_;
 
+        // Ответ на запрос, время окончания чтения запроса и трасса, если запрос попал в выборку
+        struct ResponseSlot {
+            std::unique_ptr<PendingResponse> response;
+            RequestTiming::Clock::time_point read_done;
+            TracePtr trace;
+        };
+
+        // Ответы в порядке поступления запросов. Ответ в элементе пуст, пока не готов.
+        // Первый элемент соответствует запросу с номером first_index_
+        std::deque<ResponseSlot> responses_;
+        size_t first_index_ = 0;
+        size_t next_index_ = 0;
+        size_t queued_bytes_ = 0;
+        // Запросы, ответы на которые ещё не переданы в очередь отправки
+        size_t unanswered_ = 0;
+        bool reading_ = false;
+        bool writing_ = false;
+        // Новые запросы больше не читаются: клиент закрыл соединение или не просил keep-alive
+        bool read_closed_ = false;
+        // Запись завершилась ошибкой: оставшиеся и будущие ответы отбрасываются
+        bool write_failed_ = false;
+        // Запрос на WebSocket ждёт отправки ответов на предыдущие запросы
+        std::optional<HttpRequest> upgrade_request_;
+
+        size_t RequestsInFlight() const noexcept {
+            return next_index_ - first_index_;
+        }
+
         void Read() {
             using namespace std::literals;
+            if (reading_ || read_closed_ || upgrade_request_ || RequestsInFlight() >= MAX_PIPELINED_REQUESTS
+                || queued_bytes_ >= MAX_QUEUED_BYTES)
+                return;
+
+            // Непрочитанных данных нет, а буфер вырос после большого запроса: отдаём память в пул
+            if (buffer_.size() == 0 && buffer_.capacity() > KEPT_READ_BUFFER)
+                buffer_.shrink_to_fit();
+
+            reading_ = true;
             // Очищаем запрос от прежнего значения (метод Read может быть вызван несколько раз)
             request_ = {};
             stream_.expires_after(30s);
@@ -70,11 +338,68 @@ namespace http_server {
 
         void OnRead(beast::error_code ec, [[maybe_unused]] std::size_t bytes_read) {
             using namespace std::literals;
-            if (ec == http::error::end_of_stream)
-                return Close(); // Нормальная ситуация - клиент закрыл соединение
-            if (ec)
+            const auto read_done = RequestTiming::Clock::now();
+            reading_ = false;
+            if (ec == http::error::end_of_stream) {
+                // Нормальная ситуация - клиент закрыл соединение. Ответы на уже прочитанные
+                // запросы отправляются до конца
+                read_closed_ = true;
+                if (RequestsInFlight() == 0)
+                    Close();
+                return;
+            }
+            if (ec) {
+                read_closed_ = true;
                 return ReportError(ec, "read"sv);
-            HandleRequest(std::move(request_));
+            }
+
+            if (websocket::is_upgrade(request_)) {
+                // Поток передаётся WebSocket только после отправки всех предыдущих ответов
+                if (RequestsInFlight() == 0)
+                    return HandleUpgrade(std::move(request_));
+                upgrade_request_.emplace(std::move(request_));
+                return;
+            }
+
+            if (!request_.keep_alive())
+                read_closed_ = true;
+
+            const size_t index = next_index_++;
+            auto trace = Tracer::Sample();
+            responses_.push_back({nullptr, read_done, trace});
+            // Предыдущие запросы ещё выполняются: этот не должен увидеть состояние до них
+            const bool after_pending = unanswered_++ > 0;
+            {
+                // Синхронная часть обработки видит трассу запроса как текущую
+                Tracer::Scope scope(std::move(trace));
+                HandleRequest(std::move(request_), index, after_pending);
+            }
+
+            // Читаем следующий запрос, не дожидаясь ответа на этот
+            Read();
+        }
+
+        void OnResponseReady(size_t index, std::unique_ptr<PendingResponse> response) {
+            --unanswered_;
+            if (write_failed_)
+                return;
+            queued_bytes_ += response->size;
+            responses_[index - first_index_].response = std::move(response);
+            if (!writing_)
+                DoWrite();
+        }
+
+        void DoWrite() {
+            if (write_failed_ || responses_.empty() || !responses_.front().response)
+                return;
+
+            auto& front = responses_.front();
+            if (front.trace)
+                front.trace->Mark(TraceStage::WRITE);
+            writing_ = true;
+            front.response->AsyncWrite(stream_, [self = GetSharedThis()](bool close, beast::error_code ec) {
+                self->OnWrite(close, ec);
+            });
         }
 
         void Close() {
@@ -82,18 +407,53 @@ namespace http_server {
             stream_.socket().shutdown(tcp::socket::shutdown_send, ec);
         }
 
-        void OnWrite(bool close, beast::error_code ec, [[maybe_unused]] std::size_t bytes_written) {
-            if (ec)
+        void OnWrite(bool close, beast::error_code ec) {
+            writing_ = false;
+            auto& front = responses_.front();
+            queued_bytes_ -= front.response->size;
+            if (front.response->on_written)
+                front.response->on_written({front.read_done, RequestTiming::Clock::now()});
+            if (front.trace && !ec) {
+                front.trace->Mark(TraceStage::DONE);
+                Tracer::Finish(*front.trace);
+            }
+            responses_.pop_front();
+            ++first_index_;
+
+            if (ec) {
+                // Соединение непригодно для записи: ответы на остальные запросы уже не отправить
+                read_closed_ = true;
+                write_failed_ = true;
+                responses_.clear();
+                queued_bytes_ = 0;
+                upgrade_request_.reset();
                 return ReportError(ec, "write"sv);
+            }
 
-            if (close)
+            if (close) {
+                read_closed_ = true;
                 return Close();
+            }
+
+            if (RequestsInFlight() == 0) {
+                if (upgrade_request_) {
+                    auto request = std::move(*upgrade_request_);
+                    upgrade_request_.reset();
+                    return HandleUpgrade(std::move(request));
+                }
+                if (read_closed_)
+                    return Close();
+            }
 
+            DoWrite();
+            // Чтение могло быть приостановлено из-за ограничения числа запросов или объёма ответов
             Read();
         }
 
-        // Обработку запроса делегируем подклассу
-        virtual void HandleRequest(HttpRequest&& request) = 0;
+        // Обработку запроса делегируем подклассу. Ответ передаётся в Write с тем же index.
+        // after_pending - ответы на предыдущие запросы соединения ещё не готовы
+        virtual void HandleRequest(HttpRequest&& request, size_t index, bool after_pending) = 0;
+        virtual void HandleUpgrade(HttpRequest&& request) = 0;
 
         virtual std::shared_ptr<SessionBase> GetSharedThis() = 0;
     };
@@ -110,13 +470,20 @@ namespace http_server {
     private:
         RequestHandler request_handler_;
 
-        void HandleRequest(HttpRequest&& request) override {
+        void HandleRequest(HttpRequest&& request, size_t index, bool after_pending) override {
             // Захватываем умный указатель на текущий объект Session в лямбде,
             // чтобы продлить время жизни сессии до вызова лямбды.
             // Используется generic-лямбда функция, способная принять response произвольного типа
-            request_handler_(std::move(request), [self = this->shared_from_this()](auto&& response) {
-                self->Write(std::move(response));
-                }, address_);
+            // Вторым аргументом можно передать обработчик окончания записи ответа
+            request_handler_(std::move(request), [self = this->shared_from_this(), index](auto&& response, WrittenHandler on_written = {}) {
+                self->Write(index, std::move(response), std::move(on_written));
+                }, address_, after_pending);
+        }
+
+        // Запрос на переключение на WebSocket: обработчик решает, принять его или отклонить
+        void HandleUpgrade(HttpRequest&& request) override {
+            auto ws = std::make_shared<WebSocketSession>(ReleaseStream(), ReleaseSlot());
+            request_handler_.Upgrade(std::move(request), std::move(ws), address_);
         }
 
         std::shared_ptr<SessionBase> GetSharedThis() override {
@@ -128,8 +495,10 @@ namespace http_server {
     class Listener : public std::enable_shared_from_this<Listener<RequestHandler>> {
     public:
         template <typename Handler>
-        Listener(net::io_context& ioc, const tcp::endpoint& endpoint, Handler&& request_handler)
+        Listener(net::io_context& ioc, const tcp::endpoint& endpoint, Handler&& request_handler,
+                 const ListenerOptions& options = {})
             : ioc_(ioc)
+            , max_sessions_(options.max_sessions)
             // Обработчики асинхронных операций acceptor_ будут вызываться в своём strand
             , acceptor_(net::make_strand(ioc))
             , request_handler_(std::forward<Handler>(request_handler)) {
@@ -141,6 +510,8 @@ namespace http_server {
             // Однако это может помешать повторно открыть сокет в полузакрытом состоянии.
             // Флаг reuse_address разрешает открыть сокет, когда он "наполовину закрыт"
             acceptor_.set_option(net::socket_base::reuse_address(true));
+            if (options.reuse_port)
+                SetReusePort();
             // Привязываем acceptor к адресу и порту endpoint
             acceptor_.bind(endpoint);
             // Переводим acceptor в состояние, в котором он способен принимать новые соединения
@@ -154,11 +525,29 @@ namespace http_server {
 
     private:
         net::io_context& ioc_;
+        size_t max_sessions_;
         tcp::acceptor acceptor_;
         RequestHandler request_handler_;
 
+        void SetReusePort() {
+#ifdef SO_REUSEPORT
+            acceptor_.set_option(ReusePort(true));
+#else
+            throw std::runtime_error("SO_REUSEPORT is not supported on this platform");
+#endif
+        }
+
         void AsyncRunSession(tcp::socket&& socket) {
-            std::make_shared<Session<RequestHandler>>(std::move(socket), request_handler_)->Run();
+            // Ограничение мягкое: несколько Listener могут одновременно превысить его на одну сессию
+            if (ConnectionSlot::GetActiveCount() >= max_sessions_)
+                return RejectConnection(std::move(socket));
+
+            try {
+                std::make_shared<Session<RequestHandler>>(std::move(socket), request_handler_)->Run();
+            } catch (const sys::system_error& e) {
+                // Клиент успел отключиться, и адрес сокета недоступен
+                ReportError(e.code(), "session"sv);
+            }
         }
 
         void DoAccept() {
@@ -193,10 +582,11 @@ namespace http_server {
     };
 
     template <typename RequestHandler>
-    void ServeHttp(net::io_context& ioc, const tcp::endpoint& endpoint, RequestHandler&& handler) {
+    void ServeHttp(net::io_context& ioc, const tcp::endpoint& endpoint, RequestHandler&& handler,
+                   const ListenerOptions& options = {}) {
         using MyListener = Listener<std::decay_t<RequestHandler>>;
 
-        std::make_shared<MyListener>(ioc, endpoint, std::forward<RequestHandler>(handler))->Run();
+        std::make_shared<MyListener>(ioc, endpoint, std::forward<RequestHandler>(handler), options)->Run();
     }
 
 }  // namespace http_server
\ No newline at end of file
@@ -0,0 +1,32 @@
+#include "json_arena.h"
+
+namespace http_handler {
+
+namespace {
+
+struct ArenaBuffer {
+    alignas(std::max_align_t) unsigned char data[JsonArena::BUFFER_SIZE];
+    bool in_use = false;
+};
+
+thread_local ArenaBuffer arena_buffer;
+
+}  // namespace
+
+JsonArena::JsonArena()
+    : owns_buffer_(!arena_buffer.in_use) {
+    if (owns_buffer_) {
+        arena_buffer.in_use = true;
+        resource_.emplace(arena_buffer.data, sizeof(arena_buffer.data));
+    } else {
+        resource_.emplace();
+    }
+}
+
+JsonArena::~JsonArena() {
+    resource_.reset();
+    if (owns_buffer_)
+        arena_buffer.in_use = false;
+}
+
+}  // namespace http_handler
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <boost/json.hpp>
+
+#include <cstddef>
+#include <optional>
+
+namespace http_handler {
+
+namespace json = boost::json;
+
+// Арена памяти для разбора и построения JSON в пределах обработки одного запроса.
+// Первые BUFFER_SIZE байт берутся из буфера потока, который переиспользуется между
+// запросами, поэтому обычные запросы и ответы не обращаются к куче. Всё, что выделено
+// из арены, освобождается разом при её уничтожении.
+// Значения, построенные в арене, не должны её переживать. Арены одного потока
+// не вкладываются: пока буфер занят, следующая арена берёт память из кучи
+class JsonArena {
+public:
+    static constexpr size_t BUFFER_SIZE = 16 * 1024;
+
+    JsonArena();
+    ~JsonArena();
+
+    JsonArena(const JsonArena&) = delete;
+    JsonArena& operator=(const JsonArena&) = delete;
+
+    // Невладеющий указатель на ресурс арены для конструкторов json и json::parse
+    json::storage_ptr GetStorage() noexcept { return &*resource_; }
+
+private:
+    bool owns_buffer_;
+    std::optional<json::monotonic_resource> resource_;
+};
+
+}  // namespace http_handler
@@ -0,0 +1,186 @@
+#include "json_writer.h"
+
+#include <charconv>
+#include <cmath>
+
+namespace http_handler {
+
+using namespace std::literals;
+
+namespace {
+
+// Фрагменты ключей ответов, записываемые без экранирования
+constexpr std::string_view PLAYERS_KEY = "\"players\":"sv;
+constexpr std::string_view POS_KEY = "\"pos\":"sv;
+constexpr std::string_view SPEED_KEY = "\"speed\":"sv;
+constexpr std::string_view DIR_KEY = "\"dir\":"sv;
+constexpr std::string_view REMOVED_KEY = "\"removed\":"sv;
+constexpr std::string_view TICK_KEY = "\"tick\":"sv;
+
+std::string_view DirectionToString(model::Direction dir) {
+    switch (dir) {
+        case model::Direction::NORTH: return "U"sv;
+        case model::Direction::SOUTH: return "D"sv;
+        case model::Direction::EAST:  return "R"sv;
+        case model::Direction::WEST:  return "L"sv;
+    }
+    return {};
+}
+
+}  // namespace
+
+void JsonWriter::Key(std::string_view key) {
+    String(key);
+    out_ += ':';
+    need_comma_ = false;
+}
+
+void JsonWriter::String(std::string_view value) {
+    static constexpr char hex[] = "0123456789abcdef";
+
+    Separate();
+    out_ += '"';
+    for (const char c : value) {
+        switch (c) {
+        case '"':  out_ += "\\\""sv; break;
+        case '\\': out_ += "\\\\"sv; break;
+        case '\b': out_ += "\\b"sv; break;
+        case '\f': out_ += "\\f"sv; break;
+        case '\n': out_ += "\\n"sv; break;
+        case '\r': out_ += "\\r"sv; break;
+        case '\t': out_ += "\\t"sv; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                out_ += "\\u00"sv;
+                out_ += hex[(c >> 4) & 0xF];
+                out_ += hex[c & 0xF];
+            } else {
+                out_ += c;
+            }
+        }
+    }
+    out_ += '"';
+}
+
+void JsonWriter::Int(int64_t value) {
+    Separate();
+    char buffer[24];
+    const auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out_.append(buffer, end);
+}
+
+void JsonWriter::UInt(uint64_t value) {
+    Separate();
+    char buffer[24];
+    const auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out_.append(buffer, end);
+}
+
+void JsonWriter::Double(double value) {
+    Separate();
+    if (!std::isfinite(value)) {
+        // В состоянии игры таких значений не бывает, null сохраняет ответ корректным JSON
+        out_ += "null"sv;
+        return;
+    }
+
+    // to_chars без точности даёт кратчайшую запись, однозначно восстанавливающую число,
+    // как и алгоритм Ryu в json::serialize. Остаётся привести экспоненту к его виду:
+    // 1.5e+01 -> 1.5E1, 4e-01 -> 4E-1
+    char buffer[32];
+    const auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::scientific);
+    const std::string_view text(buffer, end - buffer);
+    const size_t e = text.find('e');
+
+    out_ += text.substr(0, e);
+    out_ += 'E';
+    std::string_view exponent = text.substr(e + 1);
+    if (exponent.front() == '-') {
+        out_ += '-';
+        exponent.remove_prefix(1);
+    } else if (exponent.front() == '+') {
+        exponent.remove_prefix(1);
+    }
+    while (exponent.size() > 1 && exponent.front() == '0')
+        exponent.remove_prefix(1);
+    out_ += exponent;
+}
+
+namespace json_writer {
+
+void WriteDogs(JsonWriter& writer, const std::vector<const model::Dog*>& dogs) {
+    char id_buffer[16];
+
+    writer.BeginObject();
+    for (const auto* dog : dogs) {
+        const auto [id_end, ec] = std::to_chars(id_buffer, id_buffer + sizeof(id_buffer), dog->GetId());
+        writer.Key(std::string_view(id_buffer, id_end - id_buffer));
+
+        writer.BeginObject();
+        const auto pos = dog->GetPosition();
+        writer.RawKey(POS_KEY);
+        writer.BeginArray();
+        writer.Double(pos.x);
+        writer.Double(pos.y);
+        writer.EndArray();
+
+        const auto speed = dog->GetSpeed();
+        writer.RawKey(SPEED_KEY);
+        writer.BeginArray();
+        writer.Double(speed.vx);
+        writer.Double(speed.vy);
+        writer.EndArray();
+
+        writer.RawKey(DIR_KEY);
+        writer.String(DirectionToString(dog->GetDirection()));
+        writer.EndObject();
+    }
+    writer.EndObject();
+}
+
+void WriteState(std::string& out, const std::vector<const model::Dog*>& dogs) {
+    // Запись одной собаки занимает около 80 байт
+    out.reserve(out.size() + 16 + dogs.size() * 80);
+
+    JsonWriter writer{out};
+    writer.BeginObject();
+    writer.RawKey(PLAYERS_KEY);
+    WriteDogs(writer, dogs);
+    writer.EndObject();
+}
+
+void WriteStateDelta(std::string& out, const std::vector<const model::Dog*>& dogs, uint64_t tick) {
+    out.reserve(out.size() + 48 + dogs.size() * 80);
+
+    JsonWriter writer{out};
+    writer.BeginObject();
+    writer.RawKey(PLAYERS_KEY);
+    WriteDogs(writer, dogs);
+    // Собаки из сессии пока не удаляются, список всегда пуст
+    writer.RawKey(REMOVED_KEY);
+    writer.BeginArray();
+    writer.EndArray();
+    writer.RawKey(TICK_KEY);
+    writer.UInt(tick);
+    writer.EndObject();
+}
+
+void WritePlayers(std::string& out, const std::vector<const model::Dog*>& dogs) {
+    char id_buffer[16];
+
+    JsonWriter writer{out};
+    writer.BeginObject();
+    for (const auto* dog : dogs) {
+        const auto [id_end, ec] = std::to_chars(id_buffer, id_buffer + sizeof(id_buffer), dog->GetId());
+        writer.Key(std::string_view(id_buffer, id_end - id_buffer));
+        writer.BeginArray();
+        writer.String("name"sv);
+        writer.String(dog->GetName());
+        writer.EndArray();
+    }
+    writer.EndObject();
+}
+
+}  // namespace json_writer
+
+}  // namespace http_handler
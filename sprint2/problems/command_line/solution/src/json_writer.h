@@ -0,0 +1,59 @@
+#pragma once
+
+#include "model.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace http_handler {
+
+// Потоковая запись JSON прямо в строку, без построения json::value.
+// Формат вывода совпадает с json::serialize: без пробелов, числа с плавающей точкой
+// в кратчайшей экспоненциальной записи вида 1.5E1.
+// Запятые между элементами расставляются автоматически
+class JsonWriter {
+public:
+    explicit JsonWriter(std::string& out) noexcept
+        : out_(out) {
+    }
+
+    void BeginObject() { Separate(); out_ += '{'; need_comma_ = false; }
+    void EndObject() { out_ += '}'; need_comma_ = true; }
+    void BeginArray() { Separate(); out_ += '['; need_comma_ = false; }
+    void EndArray() { out_ += ']'; need_comma_ = true; }
+
+    void Key(std::string_view key);
+    // Ключ, заранее записанный в виде "key": - без экранирования
+    void RawKey(std::string_view fragment) { Separate(); out_ += fragment; need_comma_ = false; }
+
+    void String(std::string_view value);
+    void Int(int64_t value);
+    void UInt(uint64_t value);
+    void Double(double value);
+
+private:
+    void Separate() {
+        if (need_comma_)
+            out_ += ',';
+        need_comma_ = true;
+    }
+
+    std::string& out_;
+    bool need_comma_ = false;
+};
+
+namespace json_writer {
+    // {"players":{"<id>":{"pos":[x,y],"speed":[vx,vy],"dir":"U"},...}} - ответ /game/state
+    void WriteState(std::string& out, const std::vector<const model::Dog*>& dogs);
+    // {"<id>":["name","<name>"],...} - ответ /game/players
+    void WritePlayers(std::string& out, const std::vector<const model::Dog*>& dogs);
+    // Ответ /game/state?since: изменившиеся собаки, удалённые собаки и номер тика
+    void WriteStateDelta(std::string& out, const std::vector<const model::Dog*>& dogs, uint64_t tick);
+
+    // Объект players: собаки по идентификаторам с координатами, скоростью и направлением
+    void WriteDogs(JsonWriter& writer, const std::vector<const model::Dog*>& dogs);
+}
+
+}  // namespace http_handler
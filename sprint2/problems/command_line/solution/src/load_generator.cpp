@@ -0,0 +1,533 @@
+// Генератор нагрузки для game_server.
+// Подключает игроков, затем держит набор keep-alive соединений, каждое из которых
+// отправляет следующий запрос сразу после ответа на предыдущий. Вид запроса, игрок
+// и направление движения выбираются генератором случайных чисел с заданным seed:
+// у соединения i свой генератор с seed + i, поэтому последовательность запросов
+// повторяется от запуска к запуску. Печатает пропускную способность, процентили
+// задержки и долю ошибок по видам запросов, по желанию - отчёт в JSON.
+// Пример: game_load --connections 32 --players 200 --duration 30 --json report.json
+#define BOOST_BEAST_USE_STD_STRING_VIEW
+
+#include <boost/asio/connect.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/json.hpp>
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::literals;
+
+namespace {
+
+namespace net = boost::asio;
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace json = boost::json;
+using tcp = net::ip::tcp;
+using Clock = std::chrono::steady_clock;
+
+enum class RequestKind : size_t {
+    MAPS,
+    MAP,
+    PLAYERS,
+    STATE,
+    ACTION,
+    TICK,
+    COUNT
+};
+
+constexpr size_t KIND_COUNT = static_cast<size_t>(RequestKind::COUNT);
+constexpr std::array<std::string_view, KIND_COUNT> KIND_NAMES = {
+    "maps"sv, "map"sv, "players"sv, "state"sv, "action"sv, "tick"sv
+};
+
+// Подряд идущих ошибок соединения, после которых оно прекращает работу
+constexpr int MAX_CONSECUTIVE_ERRORS = 10;
+// Пауза перед повторным подключением растёт с числом ошибок подряд
+constexpr auto RECONNECT_BACKOFF = 100ms;
+
+struct Args {
+    std::string host = "127.0.0.1"s;
+    std::string port = "8080"s;
+    size_t connections = 16;
+    size_t players = 100;
+    unsigned threads = 1;
+    double duration = 10.;
+    // Если задано, каждое соединение отправляет ровно столько запросов, а duration не действует
+    size_t requests = 0;
+    uint64_t seed = 123456789;
+    std::string mix = "state:50,players:5,action:35,maps:5,map:5,tick:0"s;
+    unsigned tick_delta = 50;
+    std::string json_path;
+};
+
+[[nodiscard]] std::optional<Args> ParseCommandLine(int argc, const char* const argv[]) {
+    namespace po = boost::program_options;
+
+    po::options_description desc{ "All options"s };
+
+    Args args;
+    desc.add_options()
+        ("help,h", "produce help message")
+        ("host", po::value(&args.host)->value_name("address"s), "server address, 127.0.0.1 by default")
+        ("port,p", po::value(&args.port)->value_name("port"s), "server port, 8080 by default")
+        ("connections,c", po::value(&args.connections)->value_name("N"s), "keep-alive connections, 16 by default")
+        ("players,n", po::value(&args.players)->value_name("N"s), "players to join before the run, 100 by default")
+        ("threads", po::value(&args.threads)->value_name("N"s), "client I/O threads, 1 by default")
+        ("duration,d", po::value(&args.duration)->value_name("seconds"s), "run duration, 10 by default")
+        ("requests,r", po::value(&args.requests)->value_name("N"s), "requests per connection instead of a duration")
+        ("seed,s", po::value(&args.seed)->value_name("seed"s), "random seed")
+        ("mix", po::value(&args.mix)->value_name("kind:weight,..."s), "request mix over maps, map, players, state, action, tick")
+        ("tick-delta", po::value(&args.tick_delta)->value_name("milliseconds"s), "timeDelta of tick requests")
+        ("json", po::value(&args.json_path)->value_name("file"s), "write a JSON report, - for stdout");
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (vm.contains("help"s)) {
+        std::cout << desc;
+        return std::nullopt;
+    }
+    if (args.connections == 0 || args.players == 0 || args.threads == 0) {
+        throw std::runtime_error("connections, players and threads must be positive"s);
+    }
+    return args;
+}
+
+// Веса видов запросов из строки вида state:50,action:35
+std::array<double, KIND_COUNT> ParseMix(std::string_view mix) {
+    std::array<double, KIND_COUNT> weights{};
+    while (!mix.empty()) {
+        const size_t comma = mix.find(',');
+        const std::string_view item = mix.substr(0, comma);
+        mix = comma == std::string_view::npos ? std::string_view{} : mix.substr(comma + 1);
+
+        const size_t colon = item.find(':');
+        const auto kind = std::find(KIND_NAMES.begin(), KIND_NAMES.end(), item.substr(0, colon));
+        unsigned weight = 0;
+        if (colon == std::string_view::npos || kind == KIND_NAMES.end()
+            || std::from_chars(item.data() + colon + 1, item.data() + item.size(), weight).ec != std::errc{}) {
+            throw std::runtime_error("Wrong mix item: "s + std::string{item});
+        }
+        weights[kind - KIND_NAMES.begin()] = weight;
+    }
+    if (std::all_of(weights.begin(), weights.end(), [](double w) { return w == 0; }))
+        throw std::runtime_error("Request mix is empty"s);
+    return weights;
+}
+
+using Request = http::request<http::string_body>;
+using Response = http::response<http::string_body>;
+
+// Общие для всех соединений данные сценария: игроки, карты и распределение запросов.
+// После подготовки только читаются
+struct Scenario {
+    std::string host;
+    std::vector<std::string> map_ids;
+    std::vector<std::string> tokens;
+    std::array<double, KIND_COUNT> weights{};
+    unsigned tick_delta = 0;
+
+    Request MakeRequest(std::mt19937_64& rng, RequestKind& kind) const {
+        std::discrete_distribution<size_t> kinds(weights.begin(), weights.end());
+        kind = static_cast<RequestKind>(kinds(rng));
+
+        Request req;
+        req.version(11);
+        req.keep_alive(true);
+        req.set(http::field::host, host);
+
+        const auto pick = [&rng](const auto& items) -> const auto& {
+            return items[std::uniform_int_distribution<size_t>(0, items.size() - 1)(rng)];
+        };
+        const auto authorize = [&] {
+            req.set(http::field::authorization, "Bearer "s + pick(tokens));
+        };
+
+        switch (kind) {
+        case RequestKind::MAPS:
+            req.method(http::verb::get);
+            req.target("/api/v1/maps"sv);
+            break;
+        case RequestKind::MAP:
+            req.method(http::verb::get);
+            req.target("/api/v1/maps/"s + pick(map_ids));
+            break;
+        case RequestKind::PLAYERS:
+            req.method(http::verb::get);
+            req.target("/api/v1/game/players"sv);
+            authorize();
+            break;
+        case RequestKind::STATE:
+            req.method(http::verb::get);
+            req.target("/api/v1/game/state"sv);
+            authorize();
+            break;
+        case RequestKind::ACTION: {
+            static constexpr std::array<std::string_view, 5> MOVES = { "U"sv, "D"sv, "L"sv, "R"sv, ""sv };
+            req.method(http::verb::post);
+            req.target("/api/v1/game/player/action"sv);
+            authorize();
+            req.set(http::field::content_type, "application/json"sv);
+            req.body() = "{\"move\":\""s + std::string{pick(MOVES)} + "\"}"s;
+            break;
+        }
+        case RequestKind::TICK:
+            req.method(http::verb::post);
+            req.target("/api/v1/game/tick"sv);
+            req.set(http::field::content_type, "application/json"sv);
+            req.body() = "{\"timeDelta\":"s + std::to_string(tick_delta) + "}"s;
+            break;
+        default:
+            break;
+        }
+        req.prepare_payload();
+        return req;
+    }
+};
+
+struct KindStats {
+    uint64_t ok = 0;
+    uint64_t http_errors = 0;
+    uint64_t transport_errors = 0;
+    std::vector<uint32_t> latencies_us;
+
+    void Merge(const KindStats& other) {
+        ok += other.ok;
+        http_errors += other.http_errors;
+        transport_errors += other.transport_errors;
+        latencies_us.insert(latencies_us.end(), other.latencies_us.begin(), other.latencies_us.end());
+    }
+};
+
+using Stats = std::array<KindStats, KIND_COUNT>;
+
+// Соединение с сервером, отправляющее запросы по одному. Статистика своя у каждого
+// соединения и сводится после завершения работы, поэтому запись обходится без блокировок
+class Connection : public std::enable_shared_from_this<Connection> {
+public:
+    Connection(net::io_context& ioc, const tcp::resolver::results_type& endpoints, const Scenario& scenario,
+               uint64_t seed, size_t requests, Clock::time_point deadline)
+        : stream_(net::make_strand(ioc))
+        , reconnect_timer_(stream_.get_executor())
+        , endpoints_(endpoints)
+        , scenario_(scenario)
+        , rng_(seed)
+        , requests_left_(requests)
+        , deadline_(deadline) {
+    }
+
+    void Start() {
+        Connect();
+    }
+
+    const Stats& GetStats() const noexcept {
+        return stats_;
+    }
+
+    uint64_t GetConnectErrors() const noexcept {
+        return connect_errors_;
+    }
+
+private:
+    void Connect() {
+        stream_.expires_after(5s);
+        stream_.async_connect(endpoints_, [self = shared_from_this()](beast::error_code ec, const tcp::endpoint&) {
+            if (ec) {
+                ++self->connect_errors_;
+                return self->OnError(ec);
+            }
+            // Запросы маленькие, алгоритм Нейгла только добавил бы задержку
+            self->stream_.socket().set_option(tcp::no_delay(true), ec);
+            self->SendNext();
+        });
+    }
+
+    bool Finished() const {
+        return requests_left_ == 0 && (deadline_ == Clock::time_point{} || Clock::now() >= deadline_);
+    }
+
+    void SendNext() {
+        if (requests_left_ > 0)
+            --requests_left_;
+        else if (Finished())
+            return Reset();
+
+        request_ = scenario_.MakeRequest(rng_, kind_);
+        start_ = Clock::now();
+        request_sent_ = true;
+        stream_.expires_after(10s);
+        http::async_write(stream_, request_, [self = shared_from_this()](beast::error_code ec, std::size_t) {
+            if (ec)
+                return self->OnError(ec);
+            self->Read();
+        });
+    }
+
+    void Read() {
+        response_ = {};
+        http::async_read(stream_, buffer_, response_, [self = shared_from_this()](beast::error_code ec, std::size_t) {
+            if (ec)
+                return self->OnError(ec);
+            self->OnResponse();
+        });
+    }
+
+    void OnResponse() {
+        auto& stats = stats_[static_cast<size_t>(kind_)];
+        const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start_).count();
+        stats.latencies_us.push_back(static_cast<uint32_t>(std::min<int64_t>(elapsed, UINT32_MAX)));
+        if (response_.result_int() < 400)
+            ++stats.ok;
+        else
+            ++stats.http_errors;
+        consecutive_errors_ = 0;
+        request_sent_ = false;
+
+        if (!response_.keep_alive()) {
+            Reset();
+            return Finished() ? void() : Connect();
+        }
+        SendNext();
+    }
+
+    // Запрос, на который не пришёл ответ, не повторяется: соединение открывается заново
+    // и продолжает сценарий
+    void OnError(beast::error_code ec) {
+        if (request_sent_)
+            ++stats_[static_cast<size_t>(kind_)].transport_errors;
+        request_sent_ = false;
+        Reset();
+        if (++consecutive_errors_ >= MAX_CONSECUTIVE_ERRORS) {
+            std::cerr << "Connection stopped: "sv << ec.message() << std::endl;
+            return;
+        }
+        if (Finished())
+            return;
+        reconnect_timer_.expires_after(RECONNECT_BACKOFF * consecutive_errors_);
+        reconnect_timer_.async_wait([self = shared_from_this()](beast::error_code ec) {
+            if (!ec)
+                self->Connect();
+        });
+    }
+
+    void Reset() {
+        beast::error_code ignored;
+        stream_.socket().shutdown(tcp::socket::shutdown_both, ignored);
+        stream_.close();
+        buffer_.clear();
+    }
+
+    beast::tcp_stream stream_;
+    net::steady_timer reconnect_timer_;
+    const tcp::resolver::results_type& endpoints_;
+    const Scenario& scenario_;
+    std::mt19937_64 rng_;
+    size_t requests_left_;
+    Clock::time_point deadline_;
+
+    beast::flat_buffer buffer_;
+    Request request_;
+    Response response_;
+    RequestKind kind_ = RequestKind::MAPS;
+    Clock::time_point start_;
+    // Запрос отправлен, ответ ещё не получен
+    bool request_sent_ = false;
+    int consecutive_errors_ = 0;
+    uint64_t connect_errors_ = 0;
+    Stats stats_;
+};
+
+// Синхронный запрос для подготовки сценария
+Response Fetch(beast::tcp_stream& stream, const std::string& host, http::verb method, std::string_view target,
+               std::string body = {}) {
+    Request req{method, target, 11};
+    req.set(http::field::host, host);
+    req.keep_alive(true);
+    if (!body.empty()) {
+        req.set(http::field::content_type, "application/json"sv);
+        req.body() = std::move(body);
+    }
+    req.prepare_payload();
+    http::write(stream, req);
+
+    beast::flat_buffer buffer;
+    Response res;
+    http::read(stream, buffer, res);
+    if (res.result() != http::status::ok)
+        throw std::runtime_error(std::string{target} + " returned "s + std::to_string(res.result_int()) + ": "s + res.body());
+    return res;
+}
+
+// Загружает список карт и подключает игроков поровну на все карты
+Scenario PrepareScenario(net::io_context& ioc, const tcp::resolver::results_type& endpoints, const Args& args) {
+    Scenario scenario;
+    scenario.host = args.host + ':' + args.port;
+    scenario.weights = ParseMix(args.mix);
+    scenario.tick_delta = args.tick_delta;
+
+    beast::tcp_stream stream(ioc);
+    stream.connect(endpoints);
+
+    const auto maps = json::parse(Fetch(stream, scenario.host, http::verb::get, "/api/v1/maps"sv).body());
+    for (const auto& map : maps.as_array())
+        scenario.map_ids.emplace_back(map.as_object().at("id").as_string());
+    if (scenario.map_ids.empty())
+        throw std::runtime_error("Server has no maps"s);
+
+    scenario.tokens.reserve(args.players);
+    for (size_t i = 0; i < args.players; ++i) {
+        const json::object join{
+            {"userName", "load" + std::to_string(i)},
+            {"mapId", scenario.map_ids[i % scenario.map_ids.size()]}
+        };
+        const auto reply = json::parse(Fetch(stream, scenario.host, http::verb::post, "/api/v1/game/join"sv, json::serialize(join)).body());
+        scenario.tokens.emplace_back(reply.as_object().at("authToken").as_string());
+    }
+    return scenario;
+}
+
+uint32_t Percentile(const std::vector<uint32_t>& sorted, double p) {
+    if (sorted.empty())
+        return 0;
+    const auto rank = static_cast<size_t>(std::ceil(p * static_cast<double>(sorted.size())));
+    return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+void Report(const Args& args, Stats& stats, uint64_t connect_errors, double seconds) {
+    json::object kinds;
+    KindStats total;
+
+    std::cout << std::left << std::setw(10) << "kind"
+              << std::right << std::setw(10) << "requests" << std::setw(8) << "errors"
+              << std::setw(10) << "p50 us" << std::setw(10) << "p90 us" << std::setw(10) << "p99 us"
+              << std::setw(10) << "p99.9 us" << std::setw(10) << "max us" << std::endl;
+
+    const auto print = [&](std::string_view name, KindStats& s) {
+        std::sort(s.latencies_us.begin(), s.latencies_us.end());
+        const uint64_t errors = s.http_errors + s.transport_errors;
+        const uint64_t requests = s.ok + errors;
+        std::cout << std::left << std::setw(10) << name
+                  << std::right << std::setw(10) << requests << std::setw(8) << errors
+                  << std::setw(10) << Percentile(s.latencies_us, 0.5) << std::setw(10) << Percentile(s.latencies_us, 0.9)
+                  << std::setw(10) << Percentile(s.latencies_us, 0.99) << std::setw(10) << Percentile(s.latencies_us, 0.999)
+                  << std::setw(10) << (s.latencies_us.empty() ? 0 : s.latencies_us.back()) << std::endl;
+
+        return json::object{
+            {"requests", requests},
+            {"http_errors", s.http_errors},
+            {"transport_errors", s.transport_errors},
+            {"p50_us", Percentile(s.latencies_us, 0.5)},
+            {"p90_us", Percentile(s.latencies_us, 0.9)},
+            {"p99_us", Percentile(s.latencies_us, 0.99)},
+            {"p999_us", Percentile(s.latencies_us, 0.999)},
+            {"max_us", s.latencies_us.empty() ? 0 : s.latencies_us.back()}
+        };
+    };
+
+    for (size_t i = 0; i < KIND_COUNT; ++i) {
+        if (stats[i].ok + stats[i].http_errors + stats[i].transport_errors == 0)
+            continue;
+        total.Merge(stats[i]);
+        kinds[KIND_NAMES[i]] = print(KIND_NAMES[i], stats[i]);
+    }
+    auto summary = print("total"sv, total);
+
+    const uint64_t errors = total.http_errors + total.transport_errors;
+    const uint64_t requests = total.ok + errors;
+    const double throughput = seconds > 0 ? static_cast<double>(requests) / seconds : 0.;
+    std::cout << "throughput: "sv << std::fixed << std::setprecision(1) << throughput << " req/s, errors: "sv
+              << std::setprecision(3) << (requests ? 100. * static_cast<double>(errors) / static_cast<double>(requests) : 0.)
+              << "%, connect errors: "sv << connect_errors << ", elapsed: "sv << seconds << " s"sv << std::endl;
+
+    if (args.json_path.empty())
+        return;
+
+    summary["throughput_rps"] = throughput;
+    summary["elapsed_s"] = seconds;
+    summary["connect_errors"] = connect_errors;
+    const json::object report{
+        {"seed", args.seed},
+        {"connections", args.connections},
+        {"players", args.players},
+        {"mix", args.mix},
+        {"total", std::move(summary)},
+        {"kinds", std::move(kinds)}
+    };
+    if (args.json_path == "-"sv) {
+        std::cout << json::serialize(report) << std::endl;
+    } else {
+        std::ofstream out(args.json_path);
+        out << json::serialize(report) << std::endl;
+        if (!out)
+            throw std::runtime_error("Failed to write "s + args.json_path);
+    }
+}
+
+}  // namespace
+
+int main(int argc, const char* argv[]) {
+    try {
+        const auto args = ParseCommandLine(argc, argv);
+        if (!args)
+            return EXIT_SUCCESS;
+
+        net::io_context ioc(static_cast<int>(args->threads));
+        tcp::resolver resolver(ioc);
+        const auto endpoints = resolver.resolve(args->host, args->port);
+
+        const Scenario scenario = PrepareScenario(ioc, endpoints, *args);
+        std::cout << "joined "sv << scenario.tokens.size() << " players on "sv << scenario.map_ids.size() << " maps"sv << std::endl;
+
+        const auto start = Clock::now();
+        const Clock::time_point deadline = args->requests > 0
+            ? Clock::time_point{}
+            : start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(args->duration));
+
+        std::vector<std::shared_ptr<Connection>> connections;
+        for (size_t i = 0; i < args->connections; ++i) {
+            connections.push_back(std::make_shared<Connection>(ioc, endpoints, scenario, args->seed + i, args->requests, deadline));
+            connections.back()->Start();
+        }
+
+        std::vector<std::jthread> workers;
+        for (unsigned i = 1; i < args->threads; ++i)
+            workers.emplace_back([&ioc] { ioc.run(); });
+        ioc.run();
+        workers.clear();
+
+        const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        Stats stats;
+        uint64_t connect_errors = 0;
+        for (const auto& connection : connections) {
+            for (size_t i = 0; i < KIND_COUNT; ++i)
+                stats[i].Merge(connection->GetStats()[i]);
+            connect_errors += connection->GetConnectErrors();
+        }
+        Report(*args, stats, connect_errors, seconds);
+    } catch (const std::exception& ex) {
+        std::cerr << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -2,14 +2,62 @@
 
 namespace http_handler {
 
-void LoggingRequestHandler::LogResponse(const ResponseData& r, boost::chrono::system_clock::time_point start_time, const boost::beast::net::ip::address&& address) {
-    boost::chrono::duration<double> response_time = boost::chrono::system_clock::now() - start_time;
-    json::object response_data;
-    response_data["ip"] = address.to_string();
-    response_data["response_time"] = (int)(response_time.count() * 1000);
-    response_data["code"] = (int)r.code;
-    response_data["content_type"] = r.content_type.data();
-    BOOST_LOG_TRIVIAL(info) << logging::add_value(data, response_data) << "response sent";
+ResponseLogEntry::~ResponseLogEntry() {
+    // Ответ сформирован, но не записан: соединение закрылось раньше
+    if (has_response_ && parts_.load(std::memory_order_acquire) == 1) {
+        try {
+            timing_.write_done = Clock::now();
+            Log();
+        } catch (...) {
+        }
+    }
+}
+
+void ResponseLogEntry::SetResponse(ResponseData&& data) {
+    data_ = std::move(data);
+    has_response_ = true;
+    if (parts_.fetch_add(1, std::memory_order_acq_rel) == 1)
+        Log();
+}
+
+void ResponseLogEntry::SetTiming(const http_server::RequestTiming& timing) {
+    timing_ = timing;
+    if (parts_.fetch_add(1, std::memory_order_acq_rel) == 1)
+        Log();
+}
+
+void ResponseLogEntry::Log() const {
+    LoggingRequestHandler::LogResponse(logger_, data_, timing_.write_done - timing_.read_done, address_);
+}
+
+void LoggingRequestHandler::LogResponse(AsyncLogger& logger, const ResponseData& r, ResponseLogEntry::Clock::duration response_time,
+                                        const boost::beast::net::ip::address& address) {
+    const auto micros = std::chrono::duration_cast<std::chrono::microseconds>(response_time).count();
+
+    thread_local std::string response_data;
+    response_data.clear();
+
+    JsonWriter writer(response_data);
+    writer.BeginObject();
+    writer.Key("ip"sv);
+    writer.String(address.to_string());
+    writer.Key("response_time"sv);
+    writer.Int(micros / 1000);
+    writer.Key("response_time_us"sv);
+    writer.Int(micros);
+    writer.Key("code"sv);
+    writer.Int(static_cast<int>(r.code));
+    writer.Key("content_type"sv);
+    writer.String(r.content_type);
+    if (r.raw_bytes != 0) {
+        writer.Key("bytes"sv);
+        writer.UInt(r.body_bytes);
+        writer.Key("raw_bytes"sv);
+        writer.UInt(r.raw_bytes);
+    }
+    writer.EndObject();
+
+    logger.Push("response sent"sv, response_data);
 }
 
 
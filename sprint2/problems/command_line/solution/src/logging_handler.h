@@ -1,21 +1,71 @@
 #pragma once
 
+#include "async_logger.h"
+#include "json_writer.h"
 #include "request_handler.h"
 
 namespace http_handler {
 
+// Запись журнала об ответе. Её части приходят из разных потоков: ResponseData от обработчика
+// и время записи ответа от сессии. Запись выводится, когда получены обе части, или при
+// уничтожении, если соединение закрылось до записи ответа
+class ResponseLogEntry {
+public:
+    using Clock = http_server::RequestTiming::Clock;
+
+    ResponseLogEntry(AsyncLogger& logger, const boost::beast::net::ip::address& address, Clock::time_point start) noexcept
+        : logger_(logger)
+        , address_(address)
+        , timing_{start, start} {
+    }
+    ~ResponseLogEntry();
+
+    ResponseLogEntry(const ResponseLogEntry&) = delete;
+    ResponseLogEntry& operator=(const ResponseLogEntry&) = delete;
+
+    void SetResponse(ResponseData&& data);
+    void SetTiming(const http_server::RequestTiming& timing);
+
+private:
+    void Log() const;
+
+    AsyncLogger& logger_;
+    const boost::beast::net::ip::address address_;
+    ResponseData data_{};
+    http_server::RequestTiming timing_;
+    bool has_response_ = false;
+    // Число полученных частей. Кто получил вторую, тот и выводит запись
+    std::atomic<int> parts_{0};
+};
+
+// Журнал запросов и ответов. Данные записи пишутся в JSON сразу в буфер потока,
+// а метка времени и вывод выполняются потоком AsyncLogger
 class LoggingRequestHandler {
     template <typename Body, typename Allocator>
-    static void LogRequest(const http::request<Body, http::basic_fields<Allocator>>& r, const boost::beast::net::ip::address& address) {
-        json::object request_data;
-        request_data["ip"] = address.to_string();
-        request_data["URI"] = std::string(r.target());
-        request_data["method"] = r.method_string().data();
-        BOOST_LOG_TRIVIAL(info) << logging::add_value(data, request_data) << "request received";
+    void LogRequest(const http::request<Body, http::basic_fields<Allocator>>& r, const boost::beast::net::ip::address& address) const {
+        thread_local std::string request_data;
+        request_data.clear();
+
+        JsonWriter writer(request_data);
+        writer.BeginObject();
+        writer.Key("ip"sv);
+        writer.String(address.to_string());
+        writer.Key("URI"sv);
+        writer.String(r.target());
+        writer.Key("method"sv);
+        writer.String(r.method_string());
+        writer.EndObject();
+
+        logger_->Push("request received"sv, request_data);
     }
-    static void LogResponse(const ResponseData& r, boost::chrono::system_clock::time_point start_time, const boost::beast::net::ip::address&& address);
 public:
-    explicit LoggingRequestHandler(std::shared_ptr<RequestHandler> handler) : decorated_(handler) {
+    // Время ответа берётся по монотонным часам и пишется в миллисекундах и микросекундах
+    static void LogResponse(AsyncLogger& logger, const ResponseData& r, ResponseLogEntry::Clock::duration response_time,
+                            const boost::beast::net::ip::address& address);
+
+    LoggingRequestHandler(std::shared_ptr<RequestHandler> handler, AsyncLogger& logger)
+        : decorated_(handler)
+        , logger_(&logger) {
     }
 
     static void Formatter(logging::record_view const& rec, logging::formatting_ostream& strm) {
@@ -26,18 +76,40 @@ public:
         strm << "\"message\":\"" << rec[logging::expressions::smessage] << "\"}";
     }
 
+    // Время ответа считается сессией: от окончания чтения запроса до окончания записи ответа.
+    // after_pending передаётся обработчику: ответы на предыдущие запросы соединения ещё не готовы
     template <typename Body, typename Allocator, typename Send>
-    void operator () (http::request<Body, http::basic_fields<Allocator>>&& req, Send&& send, const boost::beast::net::ip::address& address) {
+    void operator () (http::request<Body, http::basic_fields<Allocator>>&& req, Send&& send, const boost::beast::net::ip::address& address,
+                      bool after_pending = false) {
+        LogRequest(req, address);
+        auto entry = std::make_shared<ResponseLogEntry>(*logger_, address, ResponseLogEntry::Clock::now());
+        auto timed_send = [send = std::forward<Send>(send), entry](auto&& response) {
+            send(response, [entry](const http_server::RequestTiming& timing) {
+                entry->SetTiming(timing);
+            });
+        };
+        auto handle { [entry](ResponseData&& resp_data) {
+                entry->SetResponse(std::move(resp_data));
+            }};
+        decorated_->operator()(std::move(req), std::move(timed_send), handle, after_pending);
+    }
+
+    // Ответ на переключение протокола отправляет WebSocketSession, поэтому время считается
+    // до решения обработчика
+    template <typename Body, typename Allocator>
+    void Upgrade(http::request<Body, http::basic_fields<Allocator>>&& req, std::shared_ptr<http_server::WebSocketSession> ws,
+                 const boost::beast::net::ip::address& address) {
         LogRequest(req, address);
-        boost::chrono::system_clock::time_point start = boost::chrono::system_clock::now();
-        auto handle { [address, start](ResponseData&& resp_data) {
-                LogResponse(std::move(resp_data), start, std::move(address));
+        const auto start = ResponseLogEntry::Clock::now();
+        auto handle { [logger = logger_, address, start](ResponseData&& resp_data) {
+                LogResponse(*logger, resp_data, ResponseLogEntry::Clock::now() - start, address);
             }};
-        decorated_->operator()(std::move(req), std::move(send), handle);
+        decorated_->Upgrade(std::move(req), std::move(ws), handle);
     }
 
 private:
     std::shared_ptr<RequestHandler> decorated_;
+    AsyncLogger* logger_;
 };
 
 }
\ No newline at end of file
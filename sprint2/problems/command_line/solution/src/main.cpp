@@ -2,9 +2,13 @@
 #include <boost/program_options.hpp>
 #include <boost/asio/signal_set.hpp>
 #include <boost/asio/io_context.hpp>
+#include <boost/log/sinks/sync_frontend.hpp>
+#include <boost/make_shared.hpp>
 #include <iostream>
+#include <memory>
 #include <optional>
 #include <thread>
+#include <vector>
 
 #include "json_loader.h"
 
@@ -27,6 +31,10 @@ struct Args {
     int tick_time;
     bool randomize_spawn = false;
     bool no_auto_tick = true;
+    bool io_per_core = false;
+    int compression_level = http_handler::ResponseCompressor::DEFAULT_LEVEL;
+    unsigned trace_sample = 0;
+    bool debug_endpoints = false;
 };
 
 [[nodiscard]] std::optional<Args> ParseCommandLine(int argc, const char* const argv[]) {
@@ -39,6 +47,10 @@ struct Args {
         // Добавляем опцию --help и её короткую версию -h
         ("help,h", "produce help message")
         ("tick-period,t", po::value(&args.tick_time)->value_name("milliseconds"s), "set tick period")
+        ("io-per-core", "accept and serve connections on a separate io_context per core")
+        ("compression-level", po::value(&args.compression_level)->value_name("0-9"s), "set API response compression level, 0 disables")
+        ("debug-endpoints", "serve /metrics and /debug/trace")
+        ("trace-sample", po::value(&args.trace_sample)->value_name("N"s), "trace every N-th request, dump at /debug/trace")
         ("config-file,c", po::value(&args.config_path)->value_name("file"s), "set config file path")
         ("www-root,w", po::value(&args.static_path)->value_name("path"s), "set static files root")
         ("randomize-spawn-points", "spawn dogs at random positions");
@@ -66,6 +78,16 @@ struct Args {
     if (vm.contains("randomize-spawn-points")) {
         args.randomize_spawn = true;
     }
+    if (vm.contains("io-per-core"s)) {
+        args.io_per_core = true;
+    }
+    if (vm.contains("debug-endpoints"s)) {
+        args.debug_endpoints = true;
+    }
+    // Трассы доступны только через /debug/trace, без него выборка не нужна
+    if (!args.debug_endpoints) {
+        args.trace_sample = 0;
+    }
 
     // С опциями программы всё в порядке, возвращаем структуру args
     return args;
@@ -74,9 +96,10 @@ struct Args {
 class Ticker : public std::enable_shared_from_this<Ticker> {
 public:
     using Strand = net::strand<net::io_context::executor_type>;
-    using Handler = std::function<void(std::chrono::milliseconds delta)>;
+    using Handler = std::function<void(std::chrono::milliseconds delta, std::function<void()> done)>;
 
-    // Функция handler будет вызываться внутри strand с интервалом period
+    // Функция handler будет вызываться внутри strand с интервалом period.
+    // Тик может завершиться асинхронно: следующий планируется после вызова done
     Ticker(Strand strand, std::chrono::milliseconds period, Handler handler)
         : strand_{ strand }
         , period_{ period }
@@ -108,11 +131,15 @@ private:
             auto delta = duration_cast<milliseconds>(this_tick - last_tick_);
             last_tick_ = this_tick;
             try {
-                handler_(delta);
+                handler_(delta, [self = shared_from_this()] {
+                    net::dispatch(self->strand_, [self] {
+                        self->ScheduleTick();
+                    });
+                });
             }
             catch (...) {
+                ScheduleTick();
             }
-            ScheduleTick();
         }
     }
 
@@ -138,54 +165,136 @@ void RunWorkers(unsigned n, const Fn& fn) {
     fn();
 }
 
-void InitLogger() {
-    logging::add_console_log(
-        std::cout,
-        //tru additional data & add message data
-        logging::keywords::format = &http_handler::LoggingRequestHandler::Formatter, //R"({"timestamp":"%TimeStamp%", "data":"%AdditionalData%", "message":"%Message%"})",
-        logging::keywords::auto_flush = true
-    );
+// Вызывает fn при выходе из области видимости, в том числе по исключению
+template <typename Fn>
+class ScopeExit {
+public:
+    explicit ScopeExit(const Fn& fn)
+        : fn_(fn) {
+    }
+    ~ScopeExit() {
+        fn_();
+    }
+
+    ScopeExit(const ScopeExit&) = delete;
+    ScopeExit& operator=(const ScopeExit&) = delete;
+
+private:
+    const Fn& fn_;
+};
+
+// Потоков основного io_context в режиме --io-per-core: соединения обслуживают потоки
+// по одному на ядро, а основному контексту остаются strand сессий и тики
+constexpr unsigned IO_PER_CORE_GAME_THREADS = 2;
+
+// Служебные сообщения Boost.Log форматируются как раньше и выводятся через тот же
+// асинхронный журнал, что и записи о запросах
+void InitLogger(http_handler::AsyncLogger& logger) {
+    using Sink = logging::sinks::synchronous_sink<http_handler::AsyncLogSinkBackend>;
+
+    auto sink = boost::make_shared<Sink>(boost::make_shared<http_handler::AsyncLogSinkBackend>(logger));
+    sink->set_formatter(&http_handler::LoggingRequestHandler::Formatter);
+    logging::core::get()->add_sink(sink);
 
     logging::add_common_attributes();
 }
 
+// Отключает приёмник Boost.Log до остановки асинхронного журнала, на который он ссылается
+class LogSinkGuard {
+public:
+    LogSinkGuard() = default;
+    LogSinkGuard(const LogSinkGuard&) = delete;
+    LogSinkGuard& operator=(const LogSinkGuard&) = delete;
+
+    ~LogSinkGuard() {
+        logging::core::get()->remove_all_sinks();
+    }
+};
+
 }  // namespace
 
 int main(int argc, const char* argv[]) {
+    // Журнал останавливается последним: при уничтожении он выводит накопленные записи
+    http_handler::AsyncLogger logger;
+    LogSinkGuard sink_guard;
+
     try {
         auto args = ParseCommandLine(argc, argv);
         if (!args) {
             return EXIT_SUCCESS;
         }
 
-        InitLogger();
+        InitLogger(logger);
+        http_server::Tracer::SetSampleRate(args->trace_sample);
+
+        const unsigned num_threads = std::thread::hardware_concurrency();
 
         // 1. Загружаем карту из файла и построить модель игры
         app::Application app{std::move(json_loader::LoadGame(args->config_path)), args->randomize_spawn};
 
-        // 2. Инициализируем io_context
-        const unsigned num_threads = std::thread::hardware_concurrency();
-        net::io_context ioc(num_threads);
+        // 2. Инициализируем io_context. В нём работают strand игровых сессий и тики.
+        // В режиме --io-per-core соединения обслуживаются отдельными io_context, по одному на ядро:
+        // у каждого свой поток и свой acceptor, и потоки не делят общую очередь обработчиков.
+        // Запросы к игре они передают в strand сессий основного io_context, которому в этом
+        // режиме достаточно нескольких потоков: иначе потоков было бы вдвое больше, чем ядер
+        const unsigned game_threads = args->io_per_core ? std::min(num_threads, IO_PER_CORE_GAME_THREADS) : num_threads;
+        net::io_context ioc(game_threads);
+        std::vector<std::unique_ptr<net::io_context>> network_contexts;
+        if (args->io_per_core) {
+            for (unsigned i = 0; i < std::max(1u, num_threads); ++i)
+                network_contexts.push_back(std::make_unique<net::io_context>(1));
+        }
 
         // 3. Добавляем асинхронный обработчик сигналов SIGINT и SIGTERM
         net::signal_set signals(ioc, SIGINT, SIGTERM);
-        signals.async_wait([&ioc](const sys::error_code& ec, [[maybe_unused]] int signal_number) {
+        signals.async_wait([&ioc, &network_contexts](const sys::error_code& ec, [[maybe_unused]] int signal_number) {
             if (!ec) {
                 std::cout << "Signal "sv << signal_number << " received"sv << std::endl;
                 ioc.stop();
+                for (auto& context : network_contexts)
+                    context->stop();
             }
             });
 
         // 4. Создаём обработчик HTTP-запросов и связываем его с моделью игры
-        auto handler = std::make_shared<http_handler::RequestHandler>(app, args->static_path.data(), ioc, args->no_auto_tick);
-        http_handler::LoggingRequestHandler log_handler{handler};
+        auto handler = std::make_shared<http_handler::RequestHandler>(app, args->static_path.data(), ioc, args->no_auto_tick,
+            args->compression_level, args->debug_endpoints);
+        http_handler::LoggingRequestHandler log_handler{handler, logger};
+
+        // Значения для /metrics, которые считываются в момент запроса метрик
+        http_handler::Metrics::AddCollector([handler = handler.get()](http_handler::MetricsWriter& writer) {
+            handler->CollectMetrics(writer);
+        });
+        http_handler::Metrics::AddCollector([&logger](http_handler::MetricsWriter& writer) {
+            const auto server_stats = http_server::GetServerStats();
+            writer.Family("http_active_connections"sv, "gauge"sv, "Open HTTP connections"sv);
+            writer.Sample("http_active_connections"sv, {}, static_cast<uint64_t>(server_stats.active));
+            writer.Family("http_accepted_connections_total"sv, "counter"sv, "Accepted HTTP connections"sv);
+            writer.Sample("http_accepted_connections_total"sv, {}, server_stats.accepted);
+            writer.Family("http_rejected_connections_total"sv, "counter"sv, "Connections rejected over the session limit"sv);
+            writer.Sample("http_rejected_connections_total"sv, {}, server_stats.rejected);
+            writer.Family("buffer_pool_hits_total"sv, "counter"sv, "Buffer pool allocations served from free lists"sv);
+            writer.Sample("buffer_pool_hits_total"sv, {}, server_stats.pool.hits);
+            writer.Family("buffer_pool_misses_total"sv, "counter"sv, "Buffer pool allocations served from the heap"sv);
+            writer.Sample("buffer_pool_misses_total"sv, {}, server_stats.pool.misses);
+
+            const auto log_stats = logger.GetStats();
+            writer.Family("log_records_written_total"sv, "counter"sv, "Log records written"sv);
+            writer.Sample("log_records_written_total"sv, {}, log_stats.written);
+            writer.Family("log_records_dropped_total"sv, "counter"sv, "Log records dropped on a full queue"sv);
+            writer.Sample("log_records_dropped_total"sv, {}, log_stats.dropped);
+        });
 
         if (!args->no_auto_tick) {
             if (args->tick_time < 1) {
                 throw std::runtime_error("Wrong tick time");
             }
+            // Каждая сессия обновляется в своём strand, параллельно с остальными картами.
+            // Следующий тик планируется, когда обновлены все сессии
             auto ticker = std::make_shared<Ticker>(handler->GetStrand(), std::chrono::milliseconds(args->tick_time),
-                [&app](std::chrono::milliseconds delta) { app.Tick((unsigned int)delta.count()); }
+                [handler](std::chrono::milliseconds delta, std::function<void()> done) {
+                    handler->Tick(delta, std::move(done));
+                }
             );
             ticker->Start();
         }
@@ -193,9 +302,13 @@ int main(int argc, const char* argv[]) {
         // 5. Запустить обработчик HTTP-запросов, делегируя их обработчику запросов
         const auto address = net::ip::make_address("0.0.0.0");
         constexpr net::ip::port_type port = 8080;
-        http_server::ServeHttp(ioc, {address, port}, [&log_handler](auto&& req, auto&& send, const net::ip::address& address) {
-            log_handler(std::forward<decltype(req)>(req), std::forward<decltype(send)>(send), address);
-        });
+        // Обработчик копируется в каждую сессию: он обслуживает и HTTP-запросы, и переход на WebSocket
+        if (network_contexts.empty()) {
+            http_server::ServeHttp(ioc, {address, port}, log_handler);
+        } else {
+            for (auto& context : network_contexts)
+                http_server::ServeHttp(*context, {address, port}, log_handler, {.reuse_port = true});
+        }
 
         // Эта надпись сообщает тестам о том, что сервер запущен и готов обрабатывать запросы
         boost::json::value starting_data{ {"port"s, port}, {"address"s, address.to_string()} };
@@ -203,9 +316,61 @@ int main(int argc, const char* argv[]) {
             << "server started"sv;
 
         // 6. Запускаем обработку асинхронных операций
-        RunWorkers(std::max(1u, num_threads), [&ioc] {
-            ioc.run();
-        });
+        const auto stop_all = [&ioc, &network_contexts] {
+            ioc.stop();
+            for (auto& context : network_contexts)
+                context->stop();
+        };
+        std::vector<std::jthread> network_workers;
+        // Разрушается раньше network_workers: если run() основного контекста выбросит исключение,
+        // потоки сетевых контекстов будут остановлены до ожидания их завершения
+        ScopeExit stop_on_exit{stop_all};
+        for (auto& context : network_contexts)
+            network_workers.emplace_back([&context] { context->run(); });
+
+        {
+            // Без автоматических тиков у основного io_context может не быть своих операций
+            std::optional<net::executor_work_guard<net::io_context::executor_type>> work;
+            if (!network_contexts.empty())
+                work.emplace(net::make_work_guard(ioc));
+
+            RunWorkers(std::max(1u, game_threads), [&ioc, &stop_all] {
+                // Исключение в одном потоке останавливает остальные, иначе RunWorkers ждал бы их вечно
+                ScopeExit stop{stop_all};
+                ioc.run();
+            });
+        }
+        network_workers.clear();
+
+        const auto& tick_stats = app.GetTickStats();
+        if (tick_stats.count > 0) {
+            BOOST_LOG_TRIVIAL(info) << logging::add_value(additional_data, http_handler::utils::TickStatsToJson(tick_stats))
+                << "tick stats"sv;
+        }
+
+        const auto cache_stats = handler->GetResponseCacheStats();
+        boost::json::value cache_data{ {"hits"s, cache_stats.hits}, {"misses"s, cache_stats.misses} };
+        BOOST_LOG_TRIVIAL(info) << logging::add_value(additional_data, cache_data)
+            << "state cache stats"sv;
+
+        const auto server_stats = http_server::GetServerStats();
+        boost::json::value server_data{
+            {"accepted"s, server_stats.accepted},
+            {"rejected"s, server_stats.rejected},
+            {"pool_hits"s, server_stats.pool.hits},
+            {"pool_misses"s, server_stats.pool.misses}
+        };
+        BOOST_LOG_TRIVIAL(info) << logging::add_value(additional_data, server_data)
+            << "http server stats"sv;
+
+        const auto log_stats = logger.GetStats();
+        boost::json::value log_data{
+            {"written"s, log_stats.written},
+            {"dropped"s, log_stats.dropped},
+            {"batches"s, log_stats.batches}
+        };
+        BOOST_LOG_TRIVIAL(info) << logging::add_value(additional_data, log_data)
+            << "log stats"sv;
 
         boost::json::value exiting_data{ {"code"s, 0} };
         BOOST_LOG_TRIVIAL(info) << logging::add_value(additional_data, exiting_data)
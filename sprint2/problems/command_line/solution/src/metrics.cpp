@@ -0,0 +1,286 @@
+#include "metrics.h"
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace http_handler {
+
+using namespace std::literals;
+
+namespace {
+
+constexpr size_t ROUTE_COUNT = static_cast<size_t>(MetricsRoute::COUNT);
+
+constexpr std::array<std::string_view, ROUTE_COUNT> ROUTE_LABELS = {
+    "api_not_found"sv, "maps"sv, "map"sv, "join"sv, "players"sv, "state"sv, "action"sv, "actions"sv, "tick"sv,
+    "static"sv, "metrics"sv, "trace"sv, "websocket"sv, "bad_request"sv
+};
+
+// Коды ответов сервера. Остальные коды учитываются вместе под меткой other
+constexpr std::array<unsigned, 12> STATUS_CODES = { 101, 200, 204, 206, 304, 400, 401, 404, 405, 416, 500, 503 };
+constexpr size_t STATUS_COUNT = STATUS_CODES.size() + 1;
+
+size_t StatusIndex(unsigned code) noexcept {
+    for (size_t i = 0; i < STATUS_CODES.size(); ++i) {
+        if (STATUS_CODES[i] == code)
+            return i;
+    }
+    return STATUS_CODES.size();
+}
+
+// Значение меняет только поток-владелец, поэтому достаточно загрузки и записи без lock-префикса
+void Add(std::atomic<uint64_t>& counter, uint64_t value) noexcept {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+struct Histogram {
+    std::array<std::atomic<uint64_t>, Metrics::BUCKETS> buckets{};
+    std::atomic<uint64_t> sum_us{0};
+
+    void Record(uint64_t micros) noexcept {
+        Add(buckets[Metrics::BucketIndex(micros)], 1);
+        Add(sum_us, micros);
+    }
+};
+
+// Сумма гистограмм всех потоков на момент вывода
+struct HistogramSnapshot {
+    std::array<uint64_t, Metrics::BUCKETS> buckets{};
+    uint64_t sum_us = 0;
+    uint64_t count = 0;
+
+    void Add(const Histogram& h) noexcept {
+        for (size_t i = 0; i < Metrics::BUCKETS; ++i) {
+            const uint64_t value = h.buckets[i].load(std::memory_order_relaxed);
+            buckets[i] += value;
+            count += value;
+        }
+        sum_us += h.sum_us.load(std::memory_order_relaxed);
+    }
+};
+
+struct alignas(64) ThreadMetrics {
+    // Публикуется потоком-владельцем после создания, читатель видит nullptr или готовую гистограмму
+    std::array<std::array<std::atomic<Histogram*>, STATUS_COUNT>, ROUTE_COUNT> requests{};
+    Histogram ticks;
+    std::atomic<uint64_t> request_bytes{0};
+    std::atomic<uint64_t> response_bytes{0};
+    // Владение гистограммами requests. Меняется только потоком-владельцем
+    std::vector<std::unique_ptr<Histogram>> owned;
+
+    Histogram& GetRequests(size_t route, size_t status) {
+        auto& slot = requests[route][status];
+        if (Histogram* histogram = slot.load(std::memory_order_relaxed))
+            return *histogram;
+        Histogram* histogram = owned.emplace_back(std::make_unique<Histogram>()).get();
+        slot.store(histogram, std::memory_order_release);
+        return *histogram;
+    }
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadMetrics>> threads;
+    std::vector<Metrics::Collector> collectors;
+};
+
+Registry& GetRegistry() {
+    static Registry registry;
+    return registry;
+}
+
+ThreadMetrics& LocalMetrics() {
+    thread_local ThreadMetrics* local = [] {
+        auto& registry = GetRegistry();
+        std::lock_guard lock(registry.mutex);
+        return registry.threads.emplace_back(std::make_unique<ThreadMetrics>()).get();
+    }();
+    return *local;
+}
+
+uint64_t ToMicros(Metrics::Clock::duration elapsed) noexcept {
+    const auto micros = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    return micros > 0 ? static_cast<uint64_t>(micros) : 0;
+}
+
+void WriteHistogram(MetricsWriter& writer, std::string_view name, std::string_view labels, const HistogramSnapshot& h) {
+    std::string bucket_name{name};
+    bucket_name += "_bucket"sv;
+    std::string bucket_labels{labels};
+    if (!bucket_labels.empty())
+        bucket_labels += ',';
+    bucket_labels += "le=\""sv;
+    const size_t le_pos = bucket_labels.size();
+
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < Metrics::BUCKETS; ++i) {
+        cumulative += h.buckets[i];
+        bucket_labels.resize(le_pos);
+        if (i + 1 == Metrics::BUCKETS) {
+            bucket_labels += "+Inf"sv;
+        } else {
+            char buffer[32];
+            const auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), Metrics::BucketBound(i));
+            bucket_labels.append(buffer, end);
+        }
+        bucket_labels += '"';
+        writer.Sample(bucket_name, bucket_labels, cumulative);
+    }
+
+    writer.Sample(std::string{name} + "_sum"s, labels, static_cast<double>(h.sum_us) / 1e6);
+    writer.Sample(std::string{name} + "_count"s, labels, h.count);
+}
+
+}  // namespace
+
+void MetricsWriter::Family(std::string_view name, std::string_view type, std::string_view help) {
+    out_ += "# HELP "sv;
+    out_ += name;
+    out_ += ' ';
+    out_ += help;
+    out_ += "\n# TYPE "sv;
+    out_ += name;
+    out_ += ' ';
+    out_ += type;
+    out_ += '\n';
+}
+
+void MetricsWriter::Sample(std::string_view name, std::string_view labels, uint64_t value) {
+    Name(name, labels);
+    char buffer[24];
+    const auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out_.append(buffer, end);
+    out_ += '\n';
+}
+
+void MetricsWriter::Sample(std::string_view name, std::string_view labels, double value) {
+    Name(name, labels);
+    char buffer[32];
+    const auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out_.append(buffer, end);
+    out_ += '\n';
+}
+
+void MetricsWriter::AppendLabel(std::string& labels, std::string_view name, std::string_view value) {
+    if (!labels.empty())
+        labels += ',';
+    labels += name;
+    labels += "=\""sv;
+    for (const char c : value) {
+        if (c == '\\' || c == '"')
+            labels += '\\';
+        if (c == '\n')
+            labels += "\\n"sv;
+        else
+            labels += c;
+    }
+    labels += '"';
+}
+
+void MetricsWriter::Name(std::string_view name, std::string_view labels) {
+    out_ += name;
+    if (!labels.empty()) {
+        out_ += '{';
+        out_ += labels;
+        out_ += '}';
+    }
+    out_ += ' ';
+}
+
+size_t Metrics::BucketIndex(uint64_t micros) noexcept {
+    // Корзина содержит значения больше предыдущей границы и не больше своей, как le в Prometheus.
+    // Поэтому октава ищется по micros - 1, а значения младших октав, где границы дробные,
+    // при необходимости переносятся в следующую корзину
+    if (micros <= 1)
+        return 0;
+    const uint64_t value = micros - 1;
+    const size_t octave = std::bit_width(value) - 1;
+    if (octave > MAX_OCTAVE)
+        return BUCKETS - 1;
+    size_t index = 1 + octave * SUB_BUCKETS + (((value - (uint64_t{1} << octave)) * SUB_BUCKETS) >> octave);
+    while (index + 1 < BUCKETS && static_cast<double>(micros) > BucketBound(index) * 1e6)
+        ++index;
+    return index;
+}
+
+double Metrics::BucketBound(size_t index) noexcept {
+    if (index == 0)
+        return 1e-6;
+    const size_t octave = (index - 1) / SUB_BUCKETS;
+    const size_t sub = (index - 1) % SUB_BUCKETS;
+    const double base = static_cast<double>(uint64_t{1} << octave);
+    return base * (1.0 + static_cast<double>(sub + 1) / SUB_BUCKETS) / 1e6;
+}
+
+void Metrics::RecordRequest(MetricsRoute route, boost::beast::http::status code, Clock::duration elapsed,
+                            uint64_t request_bytes, uint64_t response_bytes) noexcept {
+    auto& local = LocalMetrics();
+    local.GetRequests(static_cast<size_t>(route), StatusIndex(static_cast<unsigned>(code))).Record(ToMicros(elapsed));
+    Add(local.request_bytes, request_bytes);
+    Add(local.response_bytes, response_bytes);
+}
+
+void Metrics::RecordTick(Clock::duration elapsed) noexcept {
+    LocalMetrics().ticks.Record(ToMicros(elapsed));
+}
+
+void Metrics::AddCollector(Collector collector) {
+    auto& registry = GetRegistry();
+    std::lock_guard lock(registry.mutex);
+    registry.collectors.push_back(std::move(collector));
+}
+
+void Metrics::Render(std::string& out) {
+    auto& registry = GetRegistry();
+    std::lock_guard lock(registry.mutex);
+    MetricsWriter writer(out);
+
+    writer.Family("http_request_duration_seconds"sv, "histogram"sv, "Time from request parsing to response hand-off"sv);
+    std::string labels;
+    for (size_t route = 0; route < ROUTE_COUNT; ++route) {
+        for (size_t status = 0; status < STATUS_COUNT; ++status) {
+            HistogramSnapshot snapshot;
+            for (const auto& thread : registry.threads) {
+                if (const Histogram* histogram = thread->requests[route][status].load(std::memory_order_acquire))
+                    snapshot.Add(*histogram);
+            }
+            // Серии появляются с первым запросом, иначе вывод состоял бы в основном из нулей
+            if (snapshot.count == 0)
+                continue;
+
+            labels = "route=\""sv;
+            labels += ROUTE_LABELS[route];
+            labels += "\",code=\""sv;
+            labels += status < STATUS_CODES.size() ? std::to_string(STATUS_CODES[status]) : "other"s;
+            labels += '"';
+            WriteHistogram(writer, "http_request_duration_seconds"sv, labels, snapshot);
+        }
+    }
+
+    uint64_t request_bytes = 0;
+    uint64_t response_bytes = 0;
+    HistogramSnapshot ticks;
+    for (const auto& thread : registry.threads) {
+        request_bytes += thread->request_bytes.load(std::memory_order_relaxed);
+        response_bytes += thread->response_bytes.load(std::memory_order_relaxed);
+        ticks.Add(thread->ticks);
+    }
+
+    writer.Family("http_request_body_bytes_total"sv, "counter"sv, "Request body bytes received"sv);
+    writer.Sample("http_request_body_bytes_total"sv, {}, request_bytes);
+    writer.Family("http_response_body_bytes_total"sv, "counter"sv, "Response body bytes sent after compression"sv);
+    writer.Sample("http_response_body_bytes_total"sv, {}, response_bytes);
+
+    writer.Family("game_tick_duration_seconds"sv, "histogram"sv, "Duration of a game tick across all sessions"sv);
+    WriteHistogram(writer, "game_tick_duration_seconds"sv, {}, ticks);
+
+    for (const auto& collector : registry.collectors)
+        collector(writer);
+}
+
+}  // namespace http_handler
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "api_router.h"
+
+#include <boost/beast/http/status.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace http_handler {
+
+// Вид запроса для метки route: маршруты API и прочие запросы к серверу
+enum class MetricsRoute : uint8_t {
+    API_NOT_FOUND,
+    MAP_LIST,
+    MAP,
+    JOIN,
+    PLAYERS,
+    STATE,
+    ACTION,
+    ACTIONS,
+    TICK,
+    STATIC_FILE,
+    METRICS,
+    TRACE,
+    WEBSOCKET,
+    BAD_REQUEST,
+    COUNT
+};
+
+constexpr MetricsRoute ToMetricsRoute(ApiRoute route) noexcept {
+    switch (route) {
+    case ApiRoute::NOT_FOUND: return MetricsRoute::API_NOT_FOUND;
+    case ApiRoute::MAP_LIST:  return MetricsRoute::MAP_LIST;
+    case ApiRoute::MAP:       return MetricsRoute::MAP;
+    case ApiRoute::JOIN:      return MetricsRoute::JOIN;
+    case ApiRoute::PLAYERS:   return MetricsRoute::PLAYERS;
+    case ApiRoute::STATE:     return MetricsRoute::STATE;
+    case ApiRoute::ACTION:    return MetricsRoute::ACTION;
+    case ApiRoute::ACTIONS:   return MetricsRoute::ACTIONS;
+    case ApiRoute::TICK:      return MetricsRoute::TICK;
+    }
+    return MetricsRoute::API_NOT_FOUND;
+}
+
+// Запись текстового формата Prometheus. Семейство объявляется один раз через Family,
+// затем пишутся его значения. labels - готовая строка вида map="map1",... без скобок
+class MetricsWriter {
+public:
+    explicit MetricsWriter(std::string& out) noexcept
+        : out_(out) {
+    }
+
+    void Family(std::string_view name, std::string_view type, std::string_view help);
+    void Sample(std::string_view name, std::string_view labels, uint64_t value);
+    void Sample(std::string_view name, std::string_view labels, double value);
+
+    // Дописывает к labels метку name="value", через запятую после предыдущих.
+    // \, " и перевод строки в значении экранируются по правилам текстового формата
+    static void AppendLabel(std::string& labels, std::string_view name, std::string_view value);
+
+private:
+    void Name(std::string_view name, std::string_view labels);
+
+    std::string& out_;
+};
+
+// Метрики сервера. Каждый поток пишет в свой блок счётчиков и гистограмм без блокировок
+// и атомарных read-modify-write: писатель у блока один, читатель при выводе только загружает
+// значения. Блоки потоков регистрируются при первой записи и живут до конца программы.
+// Гистограммы задержек логарифмически-линейные, как в HDR Histogram: каждая октава
+// микросекунд делится на SUB_BUCKETS равных частей, поэтому относительная ошибка
+// квантилей не больше 1 / SUB_BUCKETS при постоянном числе корзин. Гистограмма пары
+// (route, code) создаётся потоком при первом таком запросе, так что блок потока
+// занимает память только под встреченные сочетания
+class Metrics {
+public:
+    static constexpr size_t SUB_BUCKETS = 8;
+    // Старшая октава: 2^26 мкс - около 67 секунд, дольше попадает в +Inf
+    static constexpr size_t MAX_OCTAVE = 26;
+    static constexpr size_t BUCKETS = 1 + SUB_BUCKETS * (MAX_OCTAVE + 1) + 1;
+
+    using Clock = std::chrono::steady_clock;
+    using Collector = std::function<void(MetricsWriter&)>;
+
+    Metrics() = delete;
+
+    // Ответ на запрос: задержка от приёма запроса до передачи ответа на запись и размеры тел
+    static void RecordRequest(MetricsRoute route, boost::beast::http::status code, Clock::duration elapsed,
+                              uint64_t request_bytes, uint64_t response_bytes) noexcept;
+    static void RecordTick(Clock::duration elapsed) noexcept;
+
+    // Источник значений, которые считаются в момент вывода: активные соединения,
+    // собаки в сессиях и т.п. Регистрируется при запуске, до начала обработки запросов
+    static void AddCollector(Collector collector);
+
+    // Все метрики в текстовом формате Prometheus
+    static void Render(std::string& out);
+
+    // Номер корзины гистограммы для значения в микросекундах
+    static size_t BucketIndex(uint64_t micros) noexcept;
+    // Верхняя граница корзины в секундах
+    static double BucketBound(size_t index) noexcept;
+};
+
+}  // namespace http_handler
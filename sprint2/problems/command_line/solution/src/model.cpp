@@ -1,5 +1,6 @@
 #include "model.h"
 
+#include <algorithm>
 #include <cmath>
 #include <stdexcept>
 
@@ -7,6 +8,8 @@ namespace model {
 using namespace std::literals;
 
 static const double MAX_DELTA = 0.4;
+// Допуск на погрешность координат, полученных сложением целого числа и MAX_DELTA
+static const double EPSILON = 1e-9;
 
 void Map::AddOffice(Office office) {
     if (warehouse_id_by_index_.contains(office.GetId())) {
@@ -24,7 +27,25 @@ void Map::AddOffice(Office office) {
     }
 }
 
+void Map::AddRoad(const Road& road) {
+    roads_.emplace_back(road);
+
+    const auto start = road.GetStart();
+    const auto end = road.GetEnd();
+    road_bounds_.min_x.push_back(std::min(start.x, end.x) - MAX_DELTA);
+    road_bounds_.max_x.push_back(std::max(start.x, end.x) + MAX_DELTA);
+    road_bounds_.min_y.push_back(std::min(start.y, end.y) - MAX_DELTA);
+    road_bounds_.max_y.push_back(std::max(start.y, end.y) + MAX_DELTA);
+}
+
+void Map::BuildRoadIndex() {
+    road_index_.Build(roads_);
+    road_graph_.Build(roads_);
+}
+
 void Game::AddMap(Map map) {
+    map.BuildRoadIndex();
+
     const size_t index = maps_.size();
     if (auto [it, inserted] = map_id_by_index_.emplace(map.GetId(), index); !inserted) {
         throw std::invalid_argument("Map with id "s + *map.GetId() + " already exists"s);
@@ -40,73 +61,129 @@ void Game::AddMap(Map map) {
 
 std::vector<const Dog*> GameSession::GetDogs() const {
     std::vector<const Dog*> result;
+    result.reserve(dogs_.size());
 
     for (const auto& dog : dogs_)
         result.emplace_back(&dog);
     return result;
 }
 
+std::vector<const Dog*> GameSession::GetDogsChangedSince(uint64_t since) const {
+    std::vector<const Dog*> result;
+    const auto& changed = states_->changed;
+
+    for (const auto& dog : dogs_) {
+        if (changed[dog.index_] >= since)
+            result.emplace_back(&dog);
+    }
+    return result;
+}
+
 Dog* GameSession::AddDog(Dog&& dog) {
-    auto roads = map_->GetRoads();
+    const auto& roads = map_->GetRoads();
+
+    Position position;
+    uint32_t road_index = 0;
 
     if (randomize_spawn_) {
         std::default_random_engine generator(roads.size());
         std::uniform_int_distribution rand_road{ 0, static_cast<int>(roads.size()) - 1 };
 
-        auto& road = roads[rand_road(generator)];
-
-        auto set_position = [&](const model::Road& road) {
-            if (road.IsHorizontal()) {
-                std::uniform_real_distribution rand_pos {
-                    static_cast<double>(road.GetStart().x),
-                    static_cast<double>(road.GetEnd().x)
-                };
-                dog.SetPosition({ rand_pos(generator), static_cast<double>(road.GetStart().y) });
-            } else {
-                std::uniform_real_distribution rand_pos {
-                    static_cast<double>(road.GetStart().y),
-                    static_cast<double>(road.GetEnd().y)
-                };
-                dog.SetPosition({ static_cast<double>(road.GetStart().x), rand_pos(generator) });
-            }
-        };
-
-        set_position(road);
+        road_index = static_cast<uint32_t>(rand_road(generator));
+        const auto& road = roads[road_index];
+
+        if (road.IsHorizontal()) {
+            std::uniform_real_distribution rand_pos {
+                static_cast<double>(std::min(road.GetStart().x, road.GetEnd().x)),
+                static_cast<double>(std::max(road.GetStart().x, road.GetEnd().x))
+            };
+            position = { rand_pos(generator), static_cast<double>(road.GetStart().y) };
+        } else {
+            std::uniform_real_distribution rand_pos {
+                static_cast<double>(std::min(road.GetStart().y, road.GetEnd().y)),
+                static_cast<double>(std::max(road.GetStart().y, road.GetEnd().y))
+            };
+            position = { static_cast<double>(road.GetStart().x), rand_pos(generator) };
+        }
     } else {
         const auto& road_start = roads[0].GetStart();
-        dog.SetPosition({ static_cast<double>(road_start.x), static_cast<double>(road_start.y) });
+        position = { static_cast<double>(road_start.x), static_cast<double>(road_start.y) };
     }
 
-    dog.ResetDirection();
-    dog.Stop();
-    dogs_.push_front(std::move(dog));
-    return &dogs_.front();
+    Dog& added = dogs_.emplace_back(std::move(dog));
+    added.states_ = states_.get();
+    added.index_ = states_->Add(position, road_index);
+    return &added;
 }
 
-GameSession::GameSession(Map* map, bool randomize_spawn)
-    : map_(map)
-    , randomize_spawn_(randomize_spawn)
-{
-    for (const auto& road : map_->GetRoads()) {
-        auto start = road.GetStart();
-        auto end = road.GetEnd();
-
-        if (road.IsHorizontal()) {
-            int start_x = std::min(start.x, end.x);
-            int end_x = std::max(start.x, end.x);
+void GameSession::Tick(unsigned delta) {
+    auto& states = *states_;
+    const size_t count = states.Size();
+    const uint64_t tick = ++states.tick;
+    const double in_seconds = static_cast<double>(delta) / 1000.0;
+
+    next_x_.resize(count);
+    next_y_.resize(count);
+    off_road_.clear();
+
+    double* x = states.x.data();
+    double* y = states.y.data();
+    const double* vx = states.vx.data();
+    const double* vy = states.vy.data();
+    const uint32_t* road = states.road.data();
+    uint64_t* changed = states.changed.data();
+    double* next_x = next_x_.data();
+    double* next_y = next_y_.data();
+
+    // 1. Конечные позиции всех собак одним проходом без ветвлений (векторизуется компилятором)
+    for (size_t i = 0; i < count; ++i) {
+        next_x[i] = x[i] + vx[i] * in_seconds;
+        next_y[i] = y[i] + vy[i] * in_seconds;
+    }
 
-            for (int x = start_x; x <= end_x; ++x)
-                roads_graph_[{x, start.y}].push_back(&road);
-        } else {
-            int start_y = std::min(start.y, end.y);
-            int end_y = std::max(start.y, end.y);
+    // 2. Собаки, которые остались в пределах своей дороги, перемещаются сразу.
+    // Стоящие собаки всегда находятся на своей дороге и не меняют координат
+    const auto& bounds = map_->GetRoadBounds();
+    const double* min_x = bounds.min_x.data();
+    const double* max_x = bounds.max_x.data();
+    const double* min_y = bounds.min_y.data();
+    const double* max_y = bounds.max_y.data();
+
+    bool any_moving = false;
+    for (size_t i = 0; i < count; ++i) {
+        const uint32_t r = road[i];
+        const bool on_road = next_x[i] >= min_x[r] && next_x[i] <= max_x[r]
+                          && next_y[i] >= min_y[r] && next_y[i] <= max_y[r];
+        const bool moving = vx[i] != 0. || vy[i] != 0.;
+        x[i] = on_road ? next_x[i] : x[i];
+        y[i] = on_road ? next_y[i] : y[i];
+        changed[i] = moving ? tick : changed[i];
+        any_moving |= moving;
+        if (!on_road)
+            off_road_.push_back(i);
+    }
 
-            for (int y = start_y; y <= end_y; ++y)
-                roads_graph_[{start.x, y}].push_back(&road);
+    if (any_moving)
+        ++states.version;
+
+    // 3. Остальные уходят со своей дороги: для них нужен поиск по графу дорог
+    for (const size_t i : off_road_) {
+        auto [stop, new_pos] = CalculateMove({x[i], y[i]}, {vx[i], vy[i]}, delta);
+        x[i] = new_pos.x;
+        y[i] = new_pos.y;
+        states.road[i] = FindRoadIndex(new_pos, states.road[i]);
+        if (stop) {
+            states.vx[i] = 0.;
+            states.vy[i] = 0.;
         }
     }
 }
 
+GameSession::GameSession(Map* map, bool randomize_spawn)
+    : map_(map)
+    , randomize_spawn_(randomize_spawn) {
+}
+
 bool IsPositionNearRoad(const Road* road, Position pos) {
     auto start_point = road->GetStart();
     auto end_point = road->GetEnd();
@@ -132,61 +209,49 @@ bool IsPositionNearRoad(const Road* road, Position pos) {
            pos.y >= min_y && pos.y <= max_y;
 }
 
-double GetMaxPossible(const Road* road, Direction dir) {
-    switch (dir) {
-    case Direction::NORTH:
-        return static_cast<double>(std::min(road->GetEnd().y, road->GetStart().y)) - MAX_DELTA;
-    case Direction::SOUTH:
-        return static_cast<double>(std::max(road->GetEnd().y, road->GetStart().y)) + MAX_DELTA;
-    case Direction::EAST:
-        return static_cast<double>(std::max(road->GetEnd().x, road->GetStart().x)) + MAX_DELTA;
-    case Direction::WEST:
-        return static_cast<double>(std::min(road->GetEnd().x, road->GetStart().x)) - MAX_DELTA;
-    }
-    return 0.;
+uint32_t GameSession::FindRoadIndex(Position pos, uint32_t fallback) const {
+    const auto& roads = map_->GetRoads();
+    uint32_t result = fallback;
+
+    map_->GetRoadIndex().ForEachRoadAt(
+        static_cast<int>(std::round(pos.x)),
+        static_cast<int>(std::round(pos.y)),
+        [&](RoadIndex::RoadId id) {
+            if (!IsPositionNearRoad(&roads[id], pos))
+                return false;
+            result = id;
+            return true;
+        });
+    return result;
 }
 
 std::pair<bool, Position> GameSession::CalculateMove(Position pos, Speed speed, unsigned delta) const {
-    double in_seconds = static_cast<double>(delta) / 1000.0;
-
-    Position end_pos = {
-        pos.x + speed.vx * in_seconds,
-        pos.y + speed.vy * in_seconds
+    const double in_seconds = static_cast<double>(delta) / 1000.0;
+    const auto& graph = map_->GetRoadGraph();
+
+    const int column = static_cast<int>(std::round(pos.x));
+    const int row = static_cast<int>(std::round(pos.y));
+
+    // Ищет границы участка, по которому можно двигаться вдоль линии.
+    // Если собака не стоит на дороге этой линии, она может сместиться только
+    // в пределах ширины поперечной дороги
+    const auto get_limits = [](std::optional<RoadGraph::Extent> extent, int cell, double offset) {
+        if (extent && std::abs(offset) <= MAX_DELTA + EPSILON)
+            return std::pair{extent->lo - MAX_DELTA, extent->hi + MAX_DELTA};
+        return std::pair{cell - MAX_DELTA, cell + MAX_DELTA};
     };
 
-    Point rounded = {
-        static_cast<int>(std::round(pos.x)),
-        static_cast<int>(std::round(pos.y))
-    };
-
-    const auto& roads = roads_graph_.at(rounded);
-
-    for (const auto* road : roads) {
-        if (IsPositionNearRoad(road, end_pos))
-            return {false, end_pos};
-
-        if (road->IsHorizontal() && speed.vy == 0.0) {
-            double max_x = (speed.vx > 0)
-                ? GetMaxPossible(road, Direction::EAST)
-                : GetMaxPossible(road, Direction::WEST);
-            return {true, {max_x, pos.y}};
-        }
-
-        if (road->IsVertical() && speed.vx == 0.0) {
-            double max_y = (speed.vy > 0)
-                ? GetMaxPossible(road, Direction::SOUTH)
-                : GetMaxPossible(road, Direction::NORTH);
-            return {true, {pos.x, max_y}};
-        }
+    if (speed.vx != 0.0) {
+        const auto [min_x, max_x] = get_limits(graph.FindHorizontal(row, column), column, pos.y - row);
+        const double target = pos.x + speed.vx * in_seconds;
+        const double x = std::clamp(target, min_x, max_x);
+        return {x != target, {x, pos.y}};
     }
 
-    if (speed.vx == 0.0) {
-        double y_limit = std::round(pos.y) + (speed.vy > 0 ? MAX_DELTA : -MAX_DELTA);
-        return {true, {pos.x, y_limit}};
-    } else {
-        double x_limit = std::round(pos.x) + (speed.vx > 0 ? MAX_DELTA : -MAX_DELTA);
-        return {true, {x_limit, pos.y}};
-    }
+    const auto [min_y, max_y] = get_limits(graph.FindVertical(column, row), row, pos.x - column);
+    const double target = pos.y + speed.vy * in_seconds;
+    const double y = std::clamp(target, min_y, max_y);
+    return {y != target, {pos.x, y}};
 }
 
 }  // namespace model
\ No newline at end of file
@@ -1,9 +1,12 @@
 #pragma once
 
+#include <atomic>
 #include <compare>
-#include <forward_list>
+#include <cstdint>
+#include <deque>
 #include <iomanip>
 #include <iostream>
+#include <memory>
 #include <random>
 #include <sstream>
 #include <string>
@@ -11,6 +14,7 @@
 #include <unordered_map>
 #include <vector>
 
+#include "road_index.h"
 #include "tagged.h"
 
 namespace model {
@@ -63,12 +67,6 @@ struct Point {
     bool operator==(const Point& other) const = default;
 };
 
-struct PointHash {
-    size_t operator()(const Point& p) const {
-        return std::hash<int>{}(p.x) ^ (std::hash<int>{}(p.y) << 1);
-    }
-};
-
 struct Size {
     Dimension width, height;
 };
@@ -149,6 +147,12 @@ private:
     Offset offset_;
 };
 
+// Границы дорог карты с учётом ширины дороги, по массиву на каждую границу
+struct RoadBounds {
+    std::vector<double> min_x, max_x;
+    std::vector<double> min_y, max_y;
+};
+
 class Map {
 public:
     using Id = util::Tagged<std::string, Map>;
@@ -167,11 +171,16 @@ public:
     const Buildings& GetBuildings() const noexcept { return buildings_; }
     const Roads& GetRoads() const noexcept { return roads_; }
     const Offices& GetOffices() const noexcept { return offices_; }
+    const RoadBounds& GetRoadBounds() const noexcept { return road_bounds_; }
+    const RoadIndex& GetRoadIndex() const noexcept { return road_index_; }
+    const RoadGraph& GetRoadGraph() const noexcept { return road_graph_; }
 
     void SetSpeed(double speed) { speed_ = speed; }
     double GetSpeed() { return speed_; }
 
-    void AddRoad(const Road& road) { roads_.emplace_back(road); }
+    void AddRoad(const Road& road);
+    // Строит индекс и граф дорог. Вызывается один раз, после добавления всех дорог
+    void BuildRoadIndex();
     void AddBuilding(const Building& building) { buildings_.emplace_back(building); }
     void AddOffice(Office office);
 
@@ -181,6 +190,9 @@ private:
     Id id_;
     std::string name_;
     Roads roads_;
+    RoadBounds road_bounds_;
+    RoadIndex road_index_;
+    RoadGraph road_graph_;
     Buildings buildings_;
     double speed_;
 
@@ -188,6 +200,43 @@ private:
     Offices offices_;
 };
 
+// Состояние собак сессии, разложенное по непрерывным массивам (structure of arrays).
+// Тик обходит эти массивы линейно, без разыменования указателей
+struct DogStates {
+    std::vector<double> x, y;
+    std::vector<double> vx, vy;
+    std::vector<Direction> direction;
+    // Индекс дороги карты, на которой сейчас находится собака
+    std::vector<uint32_t> road;
+    // Номер тика, на котором состояние собаки менялось в последний раз
+    std::vector<uint64_t> changed;
+
+    // Номер текущего тика сессии
+    uint64_t tick = 0;
+    // Увеличивается при любом видимом изменении состояния собак сессии.
+    // Счётчики атомарны: их читают обработчики запросов вне strand сессии
+    std::atomic<uint64_t> version = 0;
+    std::atomic<size_t> count = 0;
+
+    size_t Size() const noexcept { return x.size(); }
+
+    size_t Add(Position pos, uint32_t road_index) {
+        x.push_back(pos.x);
+        y.push_back(pos.y);
+        vx.push_back(0.);
+        vy.push_back(0.);
+        direction.push_back(Direction::NORTH);
+        road.push_back(road_index);
+        changed.push_back(tick);
+        count.store(x.size(), std::memory_order_release);
+        ++version;
+        return x.size() - 1;
+    }
+};
+
+// Dog - стабильный дескриптор собаки. Координаты и скорость хранятся в DogStates
+// сессии, сам объект содержит только неизменяемые данные и индекс в массивах.
+// Пользоваться методами состояния можно после добавления собаки в GameSession
 class Dog {
 public:
     explicit Dog(std::string&& name)
@@ -199,50 +248,58 @@ public:
     int GetId() const { return id_; }
     const std::string& GetName() const { return name_; }
 
-    Position GetPosition() const { return position_; }
-    Direction GetDirection() const { return direction_; }
-    Speed GetSpeed() const { return speed_; }
-
-    void SetPosition(Position pos) { position_ = pos; }
+    Position GetPosition() const { return {states_->x[index_], states_->y[index_]}; }
+    Direction GetDirection() const { return states_->direction[index_]; }
+    Speed GetSpeed() const { return {states_->vx[index_], states_->vy[index_]}; }
 
     void Move(Direction dir, double speed) {
-        direction_ = dir;
+        if (states_->direction[index_] != dir) {
+            states_->direction[index_] = dir;
+            states_->changed[index_] = states_->tick;
+            ++states_->version;
+        }
         switch (dir) {
         case Direction::NORTH:
-            speed_ = {0., -speed};
+            SetSpeed({0., -speed});
             return;
         case Direction::SOUTH:
-            speed_ = {0., speed};
+            SetSpeed({0., speed});
             return;
         case Direction::WEST:
-            speed_ = {-speed, 0.};
+            SetSpeed({-speed, 0.});
             return;
         case Direction::EAST:
-            speed_ = {speed, 0.};
+            SetSpeed({speed, 0.});
             return;
         }
     }
 
     void Stop() {
-        speed_ = {};
-    }
-
-    void ResetDirection() {
-        direction_ = Direction::NORTH;
+        SetSpeed({});
     }
 
 private:
-    inline static int start_id_ = 0;
+    friend class GameSession;
+
+    inline static std::atomic<int> start_id_ = 0;
 
     static int GetNextId() {
         return start_id_++;
     }
 
+    void SetSpeed(Speed speed) {
+        if (GetSpeed() == speed)
+            return;
+        states_->vx[index_] = speed.vx;
+        states_->vy[index_] = speed.vy;
+        states_->changed[index_] = states_->tick;
+        ++states_->version;
+    }
+
     const int id_;
     std::string name_;
-    Position position_ = {0., 0.};
-    Speed speed_ = {0., 0.};
-    Direction direction_ = Direction::NORTH;
+    DogStates* states_ = nullptr;
+    size_t index_ = 0;
 };
 
 class GameSession {
@@ -250,28 +307,34 @@ public:
     explicit GameSession(Map* map, bool randomize_spawn);
 
     std::vector<const Dog*> GetDogs() const;
+    // Собаки, состояние которых менялось начиная с тика since (включительно)
+    std::vector<const Dog*> GetDogsChangedSince(uint64_t since) const;
     Dog* AddDog(Dog&& dog);
 
+    uint64_t GetTickNumber() const noexcept { return states_->tick; }
+    // Версия состояния: одинаковые версии гарантируют одинаковое состояние собак
+    uint64_t GetStateVersion() const noexcept { return states_->version.load(std::memory_order_acquire); }
+    size_t GetDogCount() const noexcept { return states_->count.load(std::memory_order_acquire); }
+
     double GetSpeed() const { return map_->GetSpeed(); }
+    const Map& GetMap() const noexcept { return *map_; }
 
-    void Tick(unsigned delta) {
-        for (auto& dog : dogs_) {
-            if (dog.GetSpeed() != Speed{}) {
-                auto [stop, new_pos] = CalculateMove(dog.GetPosition(), dog.GetSpeed(), delta);
-                dog.SetPosition(new_pos);
-                if (stop)
-                    dog.Stop();
-            }
-        }
-    }
+    void Tick(unsigned delta);
 
 private:
-    std::forward_list<Dog> dogs_;
+    // deque не перемещает элементы при добавлении, указатели на Dog остаются валидными
+    std::deque<Dog> dogs_;
+    // unique_ptr сохраняет адрес состояния при перемещении GameSession
+    std::unique_ptr<DogStates> states_ = std::make_unique<DogStates>();
     Map* map_;
-    std::unordered_map<Point, std::vector<const Road*>, PointHash> roads_graph_;
     bool randomize_spawn_;
 
+    // Буферы тика, переиспользуются между вызовами Tick
+    std::vector<double> next_x_, next_y_;
+    std::vector<size_t> off_road_;
+
     std::pair<bool, Position> CalculateMove(Position pos, Speed speed, unsigned delta) const;
+    uint32_t FindRoadIndex(Position pos, uint32_t fallback) const;
 };
 
 class Game {
@@ -301,6 +364,9 @@ public:
             sessions_.push_back(GameSession{ &map, randomize_spawn });
     }
 
+    std::vector<GameSession>& GetSessions() noexcept { return sessions_; }
+    const std::vector<GameSession>& GetSessions() const noexcept { return sessions_; }
+
     void Tick(unsigned delta) {
         for (auto& session : sessions_)
             session.Tick(delta);
@@ -1,26 +1,76 @@
 #include "player_models.h"
 
+#include <mutex>
+
 namespace app {
 
     Player& Players::AddPlayer(model::Dog&& dog, model::GameSession* session) {
         auto* dog_ptr = session->AddDog(std::move(dog));
 
-        Token token = token_gen_.GetToken();
-        while (tokens_by_players_.contains(token))
-            token = token_gen_.GetToken();
+        // Проверка уникальности токена и вставка выполняются под мьютексом шарда,
+        // поэтому два потока не могут добавить игроков с одинаковым токеном
+        for (;;) {
+            Token token{""};
+            {
+                std::lock_guard lock{token_gen_mutex_};
+                token = token_gen_.GetToken();
+            }
+            const size_t hash = TokenHasher{}(token);
+
+            auto& shard = GetShard(hash);
+            std::lock_guard lock{shard.GetMutex()};
+            if (Player* added = shard.TryAdd(Player{std::move(token), session, dog_ptr}, hash))
+                return *added;
+        }
+    }
+
+    Player* Players::FindByToken(const Token& token) const {
+        const size_t hash = TokenHasher{}(token);
+        return GetShard(hash).Find(token, hash);
+    }
 
-        players_.emplace_back(std::move(token), session, dog_ptr);
-        tokens_by_players_.emplace(players_.back().GetToken(), players_.size() - 1);
+    Player* Players::Shard::Find(const Token& token, size_t hash) const {
+        const Table* table = table_.load(std::memory_order_acquire);
+        if (!table)
+            return nullptr;
 
-        return players_.back();
+        // Младшие биты хеша выбирают шард, для слота используются старшие
+        for (size_t i = (hash / SHARD_COUNT) & table->mask;; i = (i + 1) & table->mask) {
+            Player* player = table->slots[i].load(std::memory_order_acquire);
+            if (!player)
+                return nullptr;
+            if (player->GetToken() == token)
+                return player;
+        }
     }
 
-    Player* Players::FindByToken(const Token& token) {
-        if (const auto it = tokens_by_players_.find(token);
-            it != tokens_by_players_.end()) {
-            return &players_.at(it->second);
+    Player* Players::Shard::TryAdd(Player&& player, size_t hash) {
+        if (Find(player.GetToken(), hash))
+            return nullptr;
+
+        Player& added = players_.emplace_back(std::move(player));
+
+        const Table* current = table_.load(std::memory_order_relaxed);
+        // Заполненность таблицы не превышает половины
+        if (!current || players_.size() * 2 > current->mask + 1) {
+            const size_t capacity = current ? (current->mask + 1) * 2 : 16;
+            auto table = std::make_unique<Table>(capacity);
+            for (auto& p : players_)
+                Insert(*table, &p, TokenHasher{}(p.GetToken()));
+
+            table_.store(table.get(), std::memory_order_release);
+            tables_.emplace_back(std::move(table));
+        } else {
+            Insert(*tables_.back(), &added, hash);
         }
-        return nullptr;
+        return &added;
+    }
+
+    void Players::Shard::Insert(Table& table, Player* player, size_t hash) {
+        size_t i = (hash / SHARD_COUNT) & table.mask;
+        while (table.slots[i].load(std::memory_order_relaxed))
+            i = (i + 1) & table.mask;
+        table.slots[i].store(player, std::memory_order_release);
     }
 
 }  // namespace app
\ No newline at end of file
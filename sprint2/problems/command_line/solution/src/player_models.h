@@ -2,6 +2,14 @@
 
 #include "model.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+
 namespace detail {
     struct TokenTag {};
 }  // namespace detail
@@ -39,13 +47,14 @@ public:
         , token_(std::move(token)) {
     }
 
-    Token GetToken() const { return token_; }
+    const Token& GetToken() const noexcept { return token_; }
     model::Dog* GetDog() noexcept { return dog_; }
     int GetId() const noexcept { return id_; }
     const model::GameSession* GetSession() const noexcept { return session_; }
 
 private:
-    inline static int start_id_ = 0;
+    // Игроки входят в игру одновременно из strand разных сессий
+    inline static std::atomic<int> start_id_ = 0;
 
     static int GetNextId() {
         return start_id_++;
@@ -58,25 +67,81 @@ private:
 
 };
 
+// Реестр игроков, разбитый на шарды по хешу токена.
+// Поиск по токену не использует блокировок и может выполняться из любого потока
+// одновременно с добавлением игроков. Добавление блокирует только свой шард
 class Players {
 public:
     Player& AddPlayer(model::Dog&& dog, model::GameSession* session);
-    Player* FindByToken(const Token& token);
+    Player* FindByToken(const Token& token) const;
 
 private:
     using TokenHasher = util::TaggedHasher<Token>;
-    using TokensByPlayers = std::unordered_map<Token, size_t, TokenHasher>;
 
-    std::vector<Player> players_;
-    TokensByPlayers tokens_by_players_;
+    // Хеш-таблица с открытой адресацией. Слот, однажды заполненный, больше не меняется,
+    // поэтому читатели видят либо nullptr, либо полностью построенного игрока
+    struct Table {
+        explicit Table(size_t capacity)
+            : slots(std::make_unique<std::atomic<Player*>[]>(capacity))
+            , mask(capacity - 1) {
+        }
+
+        std::unique_ptr<std::atomic<Player*>[]> slots;
+        size_t mask;
+    };
+
+    class Shard {
+    public:
+        Player* Find(const Token& token, size_t hash) const;
+        // Вызывается под мьютексом шарда. Возвращает nullptr, если игрок с таким токеном уже есть
+        Player* TryAdd(Player&& player, size_t hash);
+
+        std::mutex& GetMutex() { return mutex_; }
+
+    private:
+        static void Insert(Table& table, Player* player, size_t hash);
+
+        std::mutex mutex_;
+        std::deque<Player> players_;
+        std::atomic<const Table*> table_ = nullptr;
+        // Прежние версии таблицы освобождаются только вместе с шардом: их может читать
+        // другой поток. Ёмкость растёт вдвое, поэтому суммарно они занимают не больше текущей
+        std::vector<std::unique_ptr<Table>> tables_;
+    };
+
+    static constexpr size_t SHARD_COUNT = 16;
+
+    Shard& GetShard(size_t hash) { return shards_[hash % SHARD_COUNT]; }
+    const Shard& GetShard(size_t hash) const { return shards_[hash % SHARD_COUNT]; }
+
+    std::array<Shard, SHARD_COUNT> shards_;
+    std::mutex token_gen_mutex_;
     PlayerToken token_gen_;
 };
 
+// Статистика времени выполнения тиков (wall time одного тика игрового мира)
+struct TickStats {
+    using Duration = std::chrono::steady_clock::duration;
+
+    Duration last{};
+    Duration max{};
+    Duration total{};
+    size_t count = 0;
+
+    void Add(Duration elapsed) {
+        last = elapsed;
+        max = std::max(max, elapsed);
+        total += elapsed;
+        ++count;
+    }
+};
+
 class Application {
 public:
     using Dogs = std::vector<const model::Dog*>;
 
-    explicit Application(model::Game&& game, bool randomize_spawn) :game_(std::move(game)) {
+    explicit Application(model::Game&& game, bool randomize_spawn)
+        : game_(std::move(game)) {
         game_.StartSessions(randomize_spawn);
     }
 
@@ -84,8 +149,10 @@ public:
     const model::Game::Maps& GetMaps() const { return game_.GetMaps(); }
 
     model::GameSession* FindSession(const model::Map::Id& id) { return game_.FindSession(id); }
+    std::vector<model::GameSession>& GetSessions() noexcept { return game_.GetSessions(); }
+    const std::vector<model::GameSession>& GetSessions() const noexcept { return game_.GetSessions(); }
     Player& AddPlayer(model::Dog&& dog, model::GameSession* session) { return players_.AddPlayer(std::move(dog), session); }
-    Player* FindByToken(const Token& token) { return players_.FindByToken(token); }
+    Player* FindByToken(const Token& token) const { return players_.FindByToken(token); }
     Dogs GetDogs(const Player* player) const { return player->GetSession()->GetDogs(); }
 
     void Move(Player* player, model::Direction dir) {
@@ -96,11 +163,17 @@ public:
         player->GetDog()->Stop();
     }
 
-    void Tick(unsigned millisec) { game_.Tick(millisec); }
+    // Учитывает длительность тика: от начала обновления до завершения последней сессии.
+    // Тики завершаются последовательно, в одном strand
+    void RecordTick(TickStats::Duration elapsed) {
+        tick_stats_.Add(elapsed);
+    }
+    const TickStats& GetTickStats() const noexcept { return tick_stats_; }
 
 private:
     model::Game game_;
     Players players_;
+    TickStats tick_stats_;
 };
 
 }  // namespace app
\ No newline at end of file
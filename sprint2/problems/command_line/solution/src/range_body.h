@@ -0,0 +1,128 @@
+#pragma once
+
+#include "http_server.h"
+
+#include <boost/optional.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace http_server {
+
+// Тело ответа 206: фрагменты файла, перед каждым из которых может идти заголовок части
+// multipart/byteranges. Фрагменты берутся из содержимого в памяти без копирования
+// или читаются из файла порциями по CHUNK_SIZE, так что файл целиком в память не загружается
+struct RangeBody {
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    struct Part {
+        // Заголовок части multipart/byteranges, для одного диапазона пуст
+        std::string prefix;
+        uint64_t offset = 0;
+        uint64_t length = 0;
+    };
+
+    struct value_type {
+        // Содержимое файла в памяти. Если пусто, фрагменты читаются из file
+        std::shared_ptr<const std::string> content;
+        beast::file file;
+        std::vector<Part> parts;
+        // Завершающая граница multipart/byteranges
+        std::string suffix;
+    };
+
+    static std::uint64_t size(const value_type& body) {
+        std::uint64_t result = body.suffix.size();
+        for (const auto& part : body.parts)
+            result += part.prefix.size() + part.length;
+        return result;
+    }
+
+    class writer {
+    public:
+        using const_buffers_type = net::const_buffer;
+
+        template <bool isRequest, typename Fields>
+        writer(const http::header<isRequest, Fields>&, value_type& body)
+            : body_(body) {
+        }
+
+        void init(beast::error_code& ec) {
+            ec = {};
+        }
+
+        boost::optional<std::pair<const_buffers_type, bool>> get(beast::error_code& ec) {
+            ec = {};
+            while (part_ < body_.parts.size()) {
+                const auto& part = body_.parts[part_];
+                if (!prefix_sent_) {
+                    prefix_sent_ = true;
+                    if (!part.prefix.empty())
+                        return {{net::const_buffer(part.prefix.data(), part.prefix.size()), true}};
+                }
+
+                if (sent_ < part.length) {
+                    auto buffer = ReadChunk(part, ec);
+                    if (ec)
+                        return boost::none;
+                    return {{buffer, true}};
+                }
+
+                ++part_;
+                prefix_sent_ = false;
+                sent_ = 0;
+            }
+
+            if (!suffix_sent_ && !body_.suffix.empty()) {
+                suffix_sent_ = true;
+                return {{net::const_buffer(body_.suffix.data(), body_.suffix.size()), false}};
+            }
+            return boost::none;
+        }
+
+    private:
+        net::const_buffer ReadChunk(const Part& part, beast::error_code& ec) {
+            const uint64_t remaining = part.length - sent_;
+            if (body_.content) {
+                // Диапазоны проверяются по размеру содержимого, но чтение за его концом исключается и здесь
+                if (part.offset + part.length > body_.content->size()) {
+                    ec = net::error::eof;
+                    return {};
+                }
+                const char* data = body_.content->data() + part.offset + sent_;
+                sent_ = part.length;
+                return net::const_buffer(data, remaining);
+            }
+
+            // Буфер нужен только для чтения из файла
+            if (chunk_.empty())
+                chunk_.resize(CHUNK_SIZE);
+
+            body_.file.seek(part.offset + sent_, ec);
+            if (ec)
+                return {};
+            const size_t count = body_.file.read(chunk_.data(), std::min<uint64_t>(remaining, chunk_.size()), ec);
+            if (ec)
+                return {};
+            if (count == 0) {
+                // Файл стал короче, чем был при запуске сервера
+                ec = net::error::eof;
+                return {};
+            }
+            sent_ += count;
+            return net::const_buffer(chunk_.data(), count);
+        }
+
+        value_type& body_;
+        size_t part_ = 0;
+        uint64_t sent_ = 0;
+        bool prefix_sent_ = false;
+        bool suffix_sent_ = false;
+        std::vector<char> chunk_;
+    };
+};
+
+}  // namespace http_server
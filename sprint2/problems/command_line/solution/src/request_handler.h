@@ -18,7 +18,10 @@ namespace net = boost::asio;
 
 class RequestHandler : public std::enable_shared_from_this<RequestHandler> {
 public:
-    explicit RequestHandler(app::Application& app, const char* path_to_static, net::io_context& ioc, bool no_auto_tick);
+    // debug_endpoints открывает /metrics и /debug/trace. Без него эти пути обрабатываются
+    // как обычные запросы статических файлов
+    RequestHandler(app::Application& app, const char* path_to_static, net::io_context& ioc, bool no_auto_tick,
+                   int compression_level = ResponseCompressor::DEFAULT_LEVEL, bool debug_endpoints = false);
 
     RequestHandler(const RequestHandler&) = delete;
     RequestHandler& operator=(const RequestHandler&) = delete;
@@ -27,48 +30,140 @@ public:
         return api_handler_->GetStrand();
     }
 
+    // after_pending - предыдущие запросы того же соединения ещё выполняются
     template <typename Body, typename Allocator, typename Send>
-    void operator()(http::request<Body, http::basic_fields<Allocator>>&& req, Send&& send, std::function<void(ResponseData&&)> handle) {
-        auto string_target = URLDecode(req.target());
-        std::string_view target(string_target);
-        switch(CheckRequest(target)) {
+    void operator()(http::request<Body, http::basic_fields<Allocator>>&& req, Send&& send, std::function<void(ResponseData&&)> handle,
+                    bool after_pending = false) {
+        std::string decoded_target;
+        const std::string_view target = DecodeTarget(req.target(), decoded_target);
+        const RequestType request_type = CheckRequest(target);
+        // Маршрут API сопоставляется один раз: по нему выбирается и метка метрик, и обработчик
+        const RouteMatch route = request_type == RequestType::API ? ApiRouter::Match(target, req.method()) : RouteMatch{};
+        if (const auto& trace = http_server::Tracer::Current()) {
+            trace->SetName(target);
+            trace->Mark(http_server::TraceStage::ROUTED);
+        }
+
+        // Ответы API сжимаются, если клиент это допускает. Размеры тела до и после сжатия
+        // попадают в ResponseData для журнала, а вместе с задержкой - в метрики
+        auto sizes = std::make_shared<ResponseSizes>();
+        CompressingSend<std::decay_t<Send>> measured_send(std::forward<Send>(send), compressor_,
+            request_type == RequestType::API || request_type == RequestType::TRACE ? compressor_.Negotiate(req.base()[http::field::accept_encoding]) : ContentEncoding::IDENTITY,
+            sizes);
+        auto measured_handle = [handle = std::move(handle), sizes, route = GetMetricsRoute(request_type, route),
+                                request_bytes = req.payload_size().value_or(0), start = Metrics::Clock::now()](ResponseData&& data) {
+            data.body_bytes = sizes->sent;
+            if (data.raw_bytes == 0)
+                data.raw_bytes = sizes->raw;
+            Metrics::RecordRequest(route, data.code, Metrics::Clock::now() - start, request_bytes, data.body_bytes);
+            handle(std::move(data));
+        };
+
+        switch(request_type) {
         case RequestType::API:
-        {
-            net::dispatch(api_handler_->GetStrand(), [self = shared_from_this(), string_target_ = std::move(string_target)
-                                                     , req_ = std::move(req), send_ = std::move(send), api_handler__ = api_handler_->shared_from_this()
-                                                     , handle_ = std::move(handle)]() {
-                    handle_(api_handler__->ProcessRequest(std::string_view(string_target_), std::move(send_), std::move(req_)));
-                });
+            // Строки route ссылаются на decoded_target и действительны только до возврата из HandleRequest
+            api_handler_->HandleRequest(route, std::move(req), std::move(measured_send), std::move(measured_handle), after_pending);
             return;
             break;
-        }
         case RequestType::FILE:
-            return handle(HttpResponseFactory::HandleFileResponseOr404(root_path_, target, std::move(send)));
+        {
+            const bool is_head_method = req.method() == http::verb::head;
+            const auto* file = static_files_.Find(target);
+            if (file == nullptr)
+                return measured_handle(HttpResponseFactory::HandleFileNotFound(std::move(measured_send), is_head_method));
+            const StaticFileRequest file_request{
+                req.base()[http::field::if_none_match],
+                req.base()[http::field::accept_encoding],
+                req.base()[http::field::range],
+                req.base()[http::field::if_range],
+                is_head_method
+            };
+            return measured_handle(HttpResponseFactory::HandleStaticFile(*file, file_request, std::move(measured_send)));
             break;
+        }
+        case RequestType::METRICS:
+        {
+            if (req.method() != http::verb::get && req.method() != http::verb::head)
+                return measured_handle(HttpResponseFactory::HandleMethodNotAllowed(std::move(measured_send), "GET, HEAD"sv));
+            auto body = std::make_shared<std::string>();
+            Metrics::Render(*body);
+            return measured_handle(HttpResponseFactory::HandleSharedResponse(http::status::ok, std::move(body),
+                std::move(measured_send), MimeType::PROMETHEUS_TEXT, req.method() == http::verb::head));
+            break;
+        }
+        case RequestType::TRACE:
+        {
+            if (req.method() != http::verb::get && req.method() != http::verb::head)
+                return measured_handle(HttpResponseFactory::HandleMethodNotAllowed(std::move(measured_send), "GET, HEAD"sv));
+            auto body = std::make_shared<std::string>();
+            http_server::Tracer::WriteChromeTrace(*body);
+            return measured_handle(HttpResponseFactory::HandleSharedResponse(http::status::ok, std::move(body),
+                std::move(measured_send), MimeType::APP_JSON, req.method() == http::verb::head));
+            break;
+        }
         case RequestType::BAD_REQUEST:
-            return handle(HttpResponseFactory::HandleBadRequest(std::move(send)));
+            return measured_handle(HttpResponseFactory::HandleBadRequest(std::move(measured_send)));
             break;
         default:
-            return handle(HttpResponseFactory::HandleBadRequest(std::move(send)));
+            return measured_handle(HttpResponseFactory::HandleBadRequest(std::move(measured_send)));
             break;
         }
     }
 
+    // Запрос на переключение соединения на WebSocket
+    template <typename Body, typename Allocator>
+    void Upgrade(http::request<Body, http::basic_fields<Allocator>>&& req, std::shared_ptr<http_server::WebSocketSession> ws,
+                 std::function<void(ResponseData&&)> handle) {
+        auto measured_handle = [handle = std::move(handle), start = Metrics::Clock::now()](ResponseData&& data) {
+            Metrics::RecordRequest(MetricsRoute::WEBSOCKET, data.code, Metrics::Clock::now() - start, 0, 0);
+            handle(std::move(data));
+        };
+
+        std::string decoded_target;
+        if (CheckRequest(DecodeTarget(req.target(), decoded_target)) != RequestType::API) {
+            ws->Reject(http::status::bad_request, RequestHttpBody::BAD_REQUEST, MimeType::APP_JSON);
+            return measured_handle({ http::status::bad_request, MimeType::APP_JSON });
+        }
+
+        api_handler_->HandleUpgrade(std::move(req), std::move(ws), std::move(measured_handle));
+    }
+
+    SessionResponseCache::Stats GetResponseCacheStats() const {
+        return api_handler_->GetResponseCacheStats();
+    }
+
+    // Обновляет все игровые сессии. done вызывается в strand тиков после завершения тика
+    void Tick(std::chrono::milliseconds delta, std::function<void()> done) {
+        api_handler_->Tick(static_cast<unsigned>(delta.count()), std::move(done));
+    }
+
+    // Метрики игровых сессий для вывода /metrics
+    void CollectMetrics(MetricsWriter& writer) const {
+        api_handler_->CollectMetrics(writer);
+    }
+
 private:
     friend APIHandler;
 
-    const fs::path root_path_;
+    const StaticFileCache static_files_;
+    const ResponseCompressor compressor_;
     std::shared_ptr<APIHandler> api_handler_;
+    const bool debug_endpoints_;
 
     enum RequestType {
         API,
         FILE,
+        METRICS,
+        // Выборка трасс запросов в формате Chrome trace-event
+        TRACE,
         BAD_REQUEST
     };
 
+    static constexpr std::string_view METRICS_TARGET = "/metrics"sv;
+    static constexpr std::string_view TRACE_TARGET = "/debug/trace"sv;
+
     RequestType CheckRequest(std::string_view target) const;
-    std::string URLDecode(std::string_view url) const;
-    int HexToInt(char c) const;
+    static MetricsRoute GetMetricsRoute(RequestType type, const RouteMatch& route) noexcept;
 };
 
 }  // namespace http_handler
\ No newline at end of file
@@ -0,0 +1,108 @@
+#include "response_cache.h"
+
+#include <cstdint>
+#include <iomanip>
+#include <sstream>
+
+namespace http_handler {
+
+namespace {
+
+// 64-битный FNV-1a: достаточно для различения версий одного ресурса
+uint64_t Fnv1a(std::string_view data) {
+    uint64_t hash = 14695981039346656037ull;
+    for (const unsigned char c : data) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+}  // namespace
+
+std::string MakeETag(std::string_view data) {
+    std::stringstream etag;
+    etag << '"' << std::hex << std::setw(16) << std::setfill('0') << Fnv1a(data) << '"';
+    return etag.str();
+}
+
+std::string MakeVariantETag(std::string_view etag, std::string_view suffix) {
+    std::string result{etag.substr(0, etag.size() - 1)};
+    result += '-';
+    result += suffix;
+    result += '"';
+    return result;
+}
+
+bool MatchesETag(std::string_view if_none_match, std::string_view etag) {
+    // Заголовок может содержать список ETag через запятую, в том числе слабых (W/"...")
+    while (!if_none_match.empty()) {
+        const size_t comma = if_none_match.find(',');
+        std::string_view tag = if_none_match.substr(0, comma);
+        if_none_match = comma == std::string_view::npos ? std::string_view{} : if_none_match.substr(comma + 1);
+
+        while (!tag.empty() && tag.front() == ' ')
+            tag.remove_prefix(1);
+        while (!tag.empty() && tag.back() == ' ')
+            tag.remove_suffix(1);
+        if (tag.starts_with("W/"sv))
+            tag.remove_prefix(2);
+
+        if (tag == "*"sv || tag == etag)
+            return true;
+    }
+    return false;
+}
+
+CachedResponse CachedResponse::FromBody(std::string body, const ResponseCompressor& compressor) {
+    CachedResponse result{std::move(body), {}, {}, {}, {}, {}};
+    result.etag = MakeETag(result.body);
+    if (compressor.ShouldCompress(result.body.size())) {
+        result.gzip = compressor.Compress(result.body, ContentEncoding::GZIP);
+        result.deflate = compressor.Compress(result.body, ContentEncoding::DEFLATE);
+        result.gzip_etag = MakeVariantETag(result.etag, "gz"sv);
+        result.deflate_etag = MakeVariantETag(result.etag, "df"sv);
+    }
+    return result;
+}
+
+std::string_view CachedResponse::GetBody(ContentEncoding& encoding) const {
+    if (encoding == ContentEncoding::GZIP && !gzip.empty())
+        return gzip;
+    if (encoding == ContentEncoding::DEFLATE && !deflate.empty())
+        return deflate;
+    encoding = ContentEncoding::IDENTITY;
+    return body;
+}
+
+std::string_view CachedResponse::GetETag(ContentEncoding encoding) const noexcept {
+    switch (encoding) {
+    case ContentEncoding::GZIP:
+        return gzip_etag;
+    case ContentEncoding::DEFLATE:
+        return deflate_etag;
+    default:
+        return etag;
+    }
+}
+
+MapResponseCache::MapResponseCache(const model::Game::Maps& maps, const ResponseCompressor& compressor) {
+    json::array map_list;
+    for (const auto& map : maps) {
+        json::object body;
+        body[std::string(model::ModelLiterals::ID)] = *map.GetId();
+        body[std::string(model::ModelLiterals::NAME)] = map.GetName();
+        map_list.emplace_back(std::move(body));
+
+        maps_.emplace(*map.GetId(), CachedResponse::FromBody(json::serialize(utils::MapToJson(&map)), compressor));
+    }
+    map_list_ = CachedResponse::FromBody(json::serialize(map_list), compressor);
+}
+
+const CachedResponse* MapResponseCache::FindMap(std::string_view id) const {
+    if (const auto it = maps_.find(id); it != maps_.end())
+        return &it->second;
+    return nullptr;
+}
+
+}  // namespace http_handler
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "compression.h"
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace http_handler {
+
+// Сильный ETag (в кавычках), вычисленный по данным
+std::string MakeETag(std::string_view data);
+// ETag сжатого варианта ресурса: "<etag>-<suffix>". У разных кодирований одного ресурса
+// разные байты тела, поэтому и сильные ETag должны различаться
+std::string MakeVariantETag(std::string_view etag, std::string_view suffix);
+// Совпадает ли etag с одним из перечисленных в заголовке If-None-Match
+bool MatchesETag(std::string_view if_none_match, std::string_view etag);
+
+// Неизменяемый ответ, сериализованный один раз при запуске сервера
+struct CachedResponse {
+    std::string body;
+    // Сильный ETag (в кавычках), вычисленный по телу ответа
+    std::string etag;
+    // Тело, сжатое один раз при построении кеша. Пусто, если тело меньше порога сжатия
+    std::string gzip;
+    std::string deflate;
+    std::string gzip_etag;
+    std::string deflate_etag;
+
+    static CachedResponse FromBody(std::string body, const ResponseCompressor& compressor);
+
+    // Тело в кодировании encoding, если такой вариант есть, иначе несжатое
+    std::string_view GetBody(ContentEncoding& encoding) const;
+    // ETag варианта, который GetBody вернул для encoding
+    std::string_view GetETag(ContentEncoding encoding) const noexcept;
+};
+
+// Кеш ответов /api/v1/maps и /api/v1/maps/{id}.
+// Карты не меняются после загрузки, поэтому все ответы готовятся заранее
+class MapResponseCache {
+public:
+    MapResponseCache(const model::Game::Maps& maps, const ResponseCompressor& compressor);
+
+    const CachedResponse& GetMapList() const noexcept { return map_list_; }
+    const CachedResponse* FindMap(std::string_view id) const;
+
+private:
+    struct StringHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view str) const { return std::hash<std::string_view>{}(str); }
+    };
+
+    CachedResponse map_list_;
+    std::unordered_map<std::string, CachedResponse, StringHash, std::equal_to<>> maps_;
+};
+
+}  // namespace http_handler
@@ -0,0 +1,135 @@
+#include "road_index.h"
+
+#include "model.h"
+
+namespace model {
+
+namespace {
+
+struct PendingSegment {
+    int line;
+    int lo, hi;
+    RoadIndex::RoadId road;
+
+    auto operator<=>(const PendingSegment&) const = default;
+};
+
+}  // namespace
+
+void RoadIndex::Build(const std::vector<Road>& roads) {
+    std::vector<PendingSegment> horizontal;
+    std::vector<PendingSegment> vertical;
+
+    for (size_t i = 0; i < roads.size(); ++i) {
+        const auto& road = roads[i];
+        const auto start = road.GetStart();
+        const auto end = road.GetEnd();
+        const auto id = static_cast<RoadId>(i);
+
+        if (road.IsHorizontal())
+            horizontal.push_back({start.y, std::min(start.x, end.x), std::max(start.x, end.x), id});
+        else
+            vertical.push_back({start.x, std::min(start.y, end.y), std::max(start.y, end.y), id});
+    }
+
+    const auto fill_axis = [](std::vector<PendingSegment>& pending, Axis& axis) {
+        std::sort(pending.begin(), pending.end());
+
+        axis.lines.clear();
+        axis.segments.clear();
+        axis.segments.reserve(pending.size());
+
+        for (const auto& s : pending) {
+            const auto index = static_cast<uint32_t>(axis.segments.size());
+            if (axis.lines.empty() || axis.lines.back().coord != s.line) {
+                axis.lines.push_back({s.line, index, index});
+                axis.segments.push_back({s.lo, s.hi, s.hi, s.road});
+            } else {
+                const int prev_max = axis.segments.back().max_hi;
+                axis.segments.push_back({s.lo, s.hi, std::max(prev_max, s.hi), s.road});
+            }
+            axis.lines.back().last = index + 1;
+        }
+
+        axis.lines.shrink_to_fit();
+    };
+
+    fill_axis(horizontal, horizontal_);
+    fill_axis(vertical, vertical_);
+}
+
+size_t RoadIndex::GetMemoryUsage() const noexcept {
+    const auto axis_usage = [](const Axis& axis) {
+        return axis.lines.capacity() * sizeof(Line) + axis.segments.capacity() * sizeof(Segment);
+    };
+    return sizeof(*this) + axis_usage(horizontal_) + axis_usage(vertical_);
+}
+
+void RoadGraph::Build(const std::vector<Road>& roads) {
+    std::vector<PendingSegment> horizontal;
+    std::vector<PendingSegment> vertical;
+
+    for (const auto& road : roads) {
+        const auto start = road.GetStart();
+        const auto end = road.GetEnd();
+
+        if (road.IsHorizontal())
+            horizontal.push_back({start.y, std::min(start.x, end.x), std::max(start.x, end.x), 0});
+        else
+            vertical.push_back({start.x, std::min(start.y, end.y), std::max(start.y, end.y), 0});
+    }
+
+    // Дороги одной линии, имеющие общую точку, сливаются в один участок.
+    // Между дорогами, разделёнными хотя бы одной единицей, остаётся разрыв шириной
+    // 1 - 2 * 0.4, который не перекрывается и поперечными дорогами
+    const auto fill_axis = [](std::vector<PendingSegment>& pending, Axis& axis) {
+        std::sort(pending.begin(), pending.end());
+
+        axis.lines.clear();
+        axis.extents.clear();
+
+        for (const auto& s : pending) {
+            const auto index = static_cast<uint32_t>(axis.extents.size());
+            if (axis.lines.empty() || axis.lines.back().coord != s.line) {
+                axis.lines.push_back({s.line, index, index + 1});
+                axis.extents.push_back({s.lo, s.hi});
+            } else if (auto& last = axis.extents.back(); s.lo <= last.hi) {
+                last.hi = std::max(last.hi, s.hi);
+            } else {
+                axis.extents.push_back({s.lo, s.hi});
+                axis.lines.back().last = index + 1;
+            }
+        }
+
+        axis.lines.shrink_to_fit();
+        axis.extents.shrink_to_fit();
+    };
+
+    fill_axis(horizontal, rows_);
+    fill_axis(vertical, columns_);
+}
+
+std::optional<RoadGraph::Extent> RoadGraph::Axis::Find(int line_coord, int pos) const {
+    const auto line = std::lower_bound(lines.begin(), lines.end(), line_coord,
+        [](const Line& l, int coord) { return l.coord < coord; });
+    if (line == lines.end() || line->coord != line_coord)
+        return std::nullopt;
+
+    const auto first = extents.begin() + line->first;
+    const auto last = extents.begin() + line->last;
+    auto it = std::upper_bound(first, last, pos,
+        [](int value, const Extent& e) { return value < e.lo; });
+
+    if (it == first || std::prev(it)->hi < pos)
+        return std::nullopt;
+    return *std::prev(it);
+}
+
+size_t RoadGraph::GetMemoryUsage() const noexcept {
+    const auto axis_usage = [](const Axis& axis) {
+        return axis.lines.capacity() * sizeof(Line) + axis.extents.capacity() * sizeof(Extent);
+    };
+    return sizeof(*this) + axis_usage(rows_) + axis_usage(columns_);
+}
+
+}  // namespace model
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace model {
+
+class Road;
+
+// Пространственный индекс дорог карты.
+// Дороги раскладываются по линиям (горизонтальные - по строкам y, вертикальные - по столбцам x),
+// внутри линии отрезки отсортированы по началу. Все данные лежат в плоских массивах,
+// поиск дорог, проходящих через точку, выполняется за O(log n + k)
+class RoadIndex {
+public:
+    using RoadId = uint32_t;
+
+    void Build(const std::vector<Road>& roads);
+
+    // Вызывает fn(RoadId) для каждой дороги, проходящей через точку (x, y).
+    // Если fn вернула true, обход прекращается, и метод возвращает true
+    template <typename Fn>
+    bool ForEachRoadAt(int x, int y, Fn&& fn) const;
+
+    // Объём памяти, занимаемый индексом, в байтах
+    size_t GetMemoryUsage() const noexcept;
+
+private:
+    struct Segment {
+        int lo, hi;
+        // Максимальный hi среди отрезков линии от первого до текущего включительно.
+        // Позволяет остановить обратный проход, когда левее не осталось подходящих отрезков
+        int max_hi;
+        RoadId road;
+    };
+
+    struct Line {
+        int coord;
+        uint32_t first, last;  // диапазон [first, last) в массиве отрезков
+    };
+
+    struct Axis {
+        std::vector<Line> lines;
+        std::vector<Segment> segments;
+
+        template <typename Fn>
+        bool ForEach(int line_coord, int pos, Fn& fn) const;
+    };
+
+    Axis horizontal_;
+    Axis vertical_;
+};
+
+template <typename Fn>
+bool RoadIndex::Axis::ForEach(int line_coord, int pos, Fn& fn) const {
+    const auto line = std::lower_bound(lines.begin(), lines.end(), line_coord,
+        [](const Line& l, int coord) { return l.coord < coord; });
+    if (line == lines.end() || line->coord != line_coord)
+        return false;
+
+    const auto first = segments.begin() + line->first;
+    const auto last = segments.begin() + line->last;
+    auto it = std::upper_bound(first, last, pos,
+        [](int value, const Segment& s) { return value < s.lo; });
+
+    while (it != first) {
+        --it;
+        if (it->max_hi < pos)
+            break;
+        if (it->hi >= pos && fn(it->road))
+            return true;
+    }
+    return false;
+}
+
+template <typename Fn>
+bool RoadIndex::ForEachRoadAt(int x, int y, Fn&& fn) const {
+    return horizontal_.ForEach(y, x, fn) || vertical_.ForEach(x, y, fn);
+}
+
+// Граф связности дорог для движения по прямой.
+// Рёбра графа - максимальные непрерывные участки строки или столбца, собранные из
+// соприкасающихся и перекрывающихся дорог. Перекрёстки внутри участка не останавливают
+// собаку, поэтому точка остановки находится одним поиском при любой длине тика
+class RoadGraph {
+public:
+    // Протяжённость участка вдоль линии в целочисленных координатах
+    struct Extent {
+        int lo, hi;
+    };
+
+    void Build(const std::vector<Road>& roads);
+
+    // Участок строки y, содержащий точку x
+    std::optional<Extent> FindHorizontal(int y, int x) const { return rows_.Find(y, x); }
+    // Участок столбца x, содержащий точку y
+    std::optional<Extent> FindVertical(int x, int y) const { return columns_.Find(x, y); }
+
+    size_t GetMemoryUsage() const noexcept;
+
+private:
+    struct Line {
+        int coord;
+        uint32_t first, last;  // диапазон [first, last) в массиве участков
+    };
+
+    struct Axis {
+        std::vector<Line> lines;
+        // Участки линии не пересекаются и отсортированы по началу
+        std::vector<Extent> extents;
+
+        std::optional<Extent> Find(int line_coord, int pos) const;
+    };
+
+    Axis rows_;
+    Axis columns_;
+};
+
+}  // namespace model
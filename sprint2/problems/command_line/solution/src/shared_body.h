@@ -0,0 +1,47 @@
+#pragma once
+
+#include "http_server.h"
+
+#include <boost/optional.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace http_server {
+
+// Тело ответа, разделяемое несколькими ответами без копирования.
+// Буфер живёт, пока на него ссылается хотя бы один ответ или кеш
+struct SharedStringBody {
+    using value_type = std::shared_ptr<const std::string>;
+
+    static std::uint64_t size(const value_type& body) {
+        return body ? body->size() : 0;
+    }
+
+    class writer {
+    public:
+        using const_buffers_type = net::const_buffer;
+
+        template <bool isRequest, typename Fields>
+        writer(const http::header<isRequest, Fields>&, const value_type& body)
+            : body_(body) {
+        }
+
+        void init(beast::error_code& ec) {
+            ec = {};
+        }
+
+        boost::optional<std::pair<const_buffers_type, bool>> get(beast::error_code& ec) {
+            ec = {};
+            if (!body_)
+                return boost::none;
+            return {{net::const_buffer(body_->data(), body_->size()), false}};
+        }
+
+    private:
+        const value_type& body_;
+    };
+};
+
+}  // namespace http_server
@@ -0,0 +1,35 @@
+#include "state_broadcaster.h"
+
+#include <algorithm>
+
+namespace http_handler {
+
+StateBroadcaster::StateBroadcaster(SessionResponseCache& cache, const std::vector<model::GameSession>& sessions)
+    : cache_(cache) {
+    for (const auto& session : sessions)
+        subscribers_.try_emplace(&session);
+}
+
+void StateBroadcaster::Subscribe(const model::GameSession* session, const std::shared_ptr<WebSocket>& ws) {
+    subscribers_.at(session).emplace_back(ws);
+}
+
+void StateBroadcaster::Broadcast(const model::GameSession& session) {
+    auto& subscribers = subscribers_.at(&session);
+
+    // Закрытые соединения больше не получают сообщений
+    std::erase_if(subscribers, [](const std::weak_ptr<WebSocket>& weak) {
+        return weak.expired();
+    });
+
+    if (subscribers.empty())
+        return;
+
+    const auto frame = MakeFrame(session);
+    for (const auto& weak : subscribers) {
+        if (auto ws = weak.lock())
+            ws->Send(frame);
+    }
+}
+
+}  // namespace http_handler
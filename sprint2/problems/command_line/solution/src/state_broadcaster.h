@@ -0,0 +1,40 @@
+#pragma once
+
+#include "state_cache.h"
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace http_handler {
+
+// Рассылка состояния игровых сессий подписчикам WebSocket.
+// Методы, относящиеся к сессии, вызываются в strand этой сессии
+class StateBroadcaster {
+public:
+    using WebSocket = http_server::WebSocketSession;
+
+    StateBroadcaster(SessionResponseCache& cache, const std::vector<model::GameSession>& sessions);
+
+    void Subscribe(const model::GameSession* session, const std::shared_ptr<WebSocket>& ws);
+
+    // Сериализует состояние сессии ровно один раз
+    // и отправляет получившееся сообщение всем её подписчикам
+    void Broadcast(const model::GameSession& session);
+
+    // Сообщение с текущим состоянием сессии в формате ответа /api/v1/game/state.
+    // Берётся из того же кеша, что и HTTP-ответы
+    WebSocket::Frame MakeFrame(const model::GameSession& session) {
+        return cache_.GetState(session);
+    }
+
+private:
+    using Subscribers = std::vector<std::weak_ptr<WebSocket>>;
+
+    SessionResponseCache& cache_;
+    // Записи создаются в конструкторе для всех сессий, поэтому strand разных сессий
+    // обращаются к таблице одновременно, не изменяя её структуру
+    std::unordered_map<const model::GameSession*, Subscribers> subscribers_;
+};
+
+}  // namespace http_handler
@@ -0,0 +1,127 @@
+#include "state_cache.h"
+
+#include "binary_state.h"
+#include "json_writer.h"
+
+namespace http_handler {
+
+namespace {
+
+size_t Index(ContentEncoding encoding) noexcept {
+    return static_cast<size_t>(encoding);
+}
+
+}  // namespace
+
+SessionResponseCache::SessionResponseCache(const std::vector<model::GameSession>& sessions, const ResponseCompressor& compressor)
+    : compressor_(compressor) {
+    for (const auto& session : sessions) {
+        states_.try_emplace(&session);
+        binary_states_.try_emplace(&session);
+        players_.try_emplace(&session);
+    }
+}
+
+template <typename Builder>
+SessionResponseCache::EncodedBody SessionResponseCache::GetOrBuild(const Entry& entry, uint64_t version, ContentEncoding encoding,
+                                                                   Builder&& build) {
+    if (auto body = TryGet(entry, version, encoding))
+        return std::move(*body);
+
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    // Сериализация выполняется без блокировки, чтобы не задерживать параллельных читателей
+    auto body = std::make_shared<const std::string>(build());
+
+    {
+        std::lock_guard lock{entry.mutex};
+        if (entry.version != version) {
+            entry.version = version;
+            entry.bodies = {};
+        }
+        entry.bodies[Index(ContentEncoding::IDENTITY)] = body;
+    }
+    return Encode(entry, version, std::move(body), encoding);
+}
+
+std::optional<SessionResponseCache::EncodedBody> SessionResponseCache::TryGet(const Entry& entry, uint64_t version,
+                                                                              ContentEncoding encoding) const {
+    Body identity;
+    {
+        std::lock_guard lock{entry.mutex};
+        identity = entry.bodies[Index(ContentEncoding::IDENTITY)];
+        if (!identity || entry.version != version)
+            return std::nullopt;
+
+        const uint64_t raw_size = identity->size();
+        if (encoding == ContentEncoding::IDENTITY || !compressor_.ShouldCompress(raw_size)) {
+            hits_.fetch_add(1, std::memory_order_relaxed);
+            return EncodedBody{ std::move(identity), ContentEncoding::IDENTITY, raw_size };
+        }
+        if (const auto& encoded = entry.bodies[Index(encoding)]) {
+            hits_.fetch_add(1, std::memory_order_relaxed);
+            return EncodedBody{ encoded, encoding, raw_size };
+        }
+    }
+
+    // Несжатое тело этой версии уже есть: недостающий вариант строится из него без strand
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    return Encode(entry, version, std::move(identity), encoding);
+}
+
+SessionResponseCache::EncodedBody SessionResponseCache::Encode(const Entry& entry, uint64_t version, Body identity,
+                                                               ContentEncoding encoding) const {
+    const uint64_t raw_size = identity->size();
+    if (encoding == ContentEncoding::IDENTITY || !compressor_.ShouldCompress(raw_size))
+        return { std::move(identity), ContentEncoding::IDENTITY, raw_size };
+
+    auto encoded = std::make_shared<const std::string>(compressor_.Compress(*identity, encoding));
+
+    std::lock_guard lock{entry.mutex};
+    // Пока тело сжималось, версия могла смениться: устаревший вариант отдаётся, но не сохраняется
+    if (entry.version == version && entry.bodies[Index(ContentEncoding::IDENTITY)] == identity)
+        entry.bodies[Index(encoding)] = encoded;
+    return { std::move(encoded), encoding, raw_size };
+}
+
+std::optional<SessionResponseCache::EncodedBody> SessionResponseCache::TryGetState(const model::GameSession& session,
+                                                                                   ContentEncoding encoding) const {
+    return TryGet(states_.at(&session), session.GetStateVersion(), encoding);
+}
+
+std::optional<SessionResponseCache::EncodedBody> SessionResponseCache::TryGetBinaryState(const model::GameSession& session) const {
+    return TryGet(binary_states_.at(&session), session.GetStateVersion(), ContentEncoding::IDENTITY);
+}
+
+std::optional<SessionResponseCache::EncodedBody> SessionResponseCache::TryGetPlayers(const model::GameSession& session,
+                                                                                     ContentEncoding encoding) const {
+    return TryGet(players_.at(&session), session.GetDogCount(), encoding);
+}
+
+SessionResponseCache::EncodedBody SessionResponseCache::GetState(const model::GameSession& session, ContentEncoding encoding) {
+    return GetOrBuild(states_.at(&session), session.GetStateVersion(), encoding, [&session] {
+        std::string body;
+        json_writer::WriteState(body, session.GetDogs());
+        return body;
+    });
+}
+
+SessionResponseCache::EncodedBody SessionResponseCache::GetBinaryState(const model::GameSession& session) {
+    // Номер тика в заголовке - тик построения тела: пока версия не изменилась,
+    // состояние с этого тика не менялось
+    return GetOrBuild(binary_states_.at(&session), session.GetStateVersion(), ContentEncoding::IDENTITY, [&session] {
+        std::string body;
+        binary_state::WriteState(body, session.GetDogs(), session.GetTickNumber());
+        return body;
+    });
+}
+
+SessionResponseCache::EncodedBody SessionResponseCache::GetPlayers(const model::GameSession& session, ContentEncoding encoding) {
+    // Список игроков меняется только при входе новой собаки в сессию
+    return GetOrBuild(players_.at(&session), session.GetDogCount(), encoding, [&session] {
+        std::string body;
+        json_writer::WritePlayers(body, session.GetDogs());
+        return body;
+    });
+}
+
+}  // namespace http_handler
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "compression.h"
+#include "handler_utils.h"
+#include "shared_body.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace http_handler {
+
+// Кеш тел ответов /api/v1/game/state и /api/v1/game/players.
+// Пока состояние сессии не изменилось, все её игроки получают одинаковые ответы,
+// поэтому тело строится при первом запросе после изменения, а последующие ответы
+// ссылаются на тот же буфер.
+// Сжатые варианты JSON-тел строятся из несжатого один раз на версию, при первом запросе
+// с таким кодированием, и отдаются с готовым Content-Encoding.
+// TryGet* можно вызывать из любого потока: они отдают тело, только если оно построено
+// для текущей версии сессии. Get* строят тело заново и вызываются в strand сессии
+class SessionResponseCache {
+public:
+    using Body = http_server::SharedStringBody::value_type;
+
+    // Тело в кодировании encoding. Тело меньше порога сжатия отдаётся несжатым с IDENTITY
+    struct EncodedBody {
+        Body body;
+        ContentEncoding encoding = ContentEncoding::IDENTITY;
+        // Размер несжатого тела, для журнала
+        uint64_t raw_size = 0;
+    };
+
+    SessionResponseCache(const std::vector<model::GameSession>& sessions, const ResponseCompressor& compressor);
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+    };
+
+    Body GetState(const model::GameSession& session) {
+        return GetState(session, ContentEncoding::IDENTITY).body;
+    }
+    EncodedBody GetState(const model::GameSession& session, ContentEncoding encoding);
+    // Состояние в двоичном формате binary_state. Не сжимается
+    EncodedBody GetBinaryState(const model::GameSession& session);
+    EncodedBody GetPlayers(const model::GameSession& session, ContentEncoding encoding);
+
+    std::optional<EncodedBody> TryGetState(const model::GameSession& session, ContentEncoding encoding) const;
+    std::optional<EncodedBody> TryGetBinaryState(const model::GameSession& session) const;
+    std::optional<EncodedBody> TryGetPlayers(const model::GameSession& session, ContentEncoding encoding) const;
+
+    Stats GetStats() const noexcept {
+        return { hits_.load(std::memory_order_relaxed), misses_.load(std::memory_order_relaxed) };
+    }
+
+private:
+    // Содержимое записи защищено её мьютексом и может дополняться сжатыми вариантами
+    // из TryGet, поэтому изменяемо и в константной записи
+    struct Entry {
+        mutable std::mutex mutex;
+        mutable uint64_t version = 0;
+        // Тела по номеру ContentEncoding. Несжатое строится первым, остальные - из него
+        mutable std::array<Body, CONTENT_ENCODING_COUNT> bodies;
+    };
+    // Записи создаются в конструкторе для всех сессий, после этого таблицы только читаются
+    using Entries = std::unordered_map<const model::GameSession*, Entry>;
+
+    template <typename Builder>
+    EncodedBody GetOrBuild(const Entry& entry, uint64_t version, ContentEncoding encoding, Builder&& build);
+    std::optional<EncodedBody> TryGet(const Entry& entry, uint64_t version, ContentEncoding encoding) const;
+    // Сжимает несжатое тело версии version и сохраняет вариант, если версия записи не сменилась
+    EncodedBody Encode(const Entry& entry, uint64_t version, Body identity, ContentEncoding encoding) const;
+
+    const ResponseCompressor& compressor_;
+
+    Entries states_;
+    Entries binary_states_;
+    Entries players_;
+    mutable std::atomic<uint64_t> hits_{0};
+    mutable std::atomic<uint64_t> misses_{0};
+};
+
+}  // namespace http_handler
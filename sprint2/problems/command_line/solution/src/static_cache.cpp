@@ -0,0 +1,107 @@
+#include "static_cache.h"
+
+#include "response_cache.h"
+
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+
+namespace http_handler {
+
+namespace {
+
+constexpr std::string_view INDEX = "/index.html"sv;
+constexpr std::string_view GZIP_SUFFIX = ".gz"sv;
+constexpr std::string_view BROTLI_SUFFIX = ".br"sv;
+
+std::shared_ptr<const std::string> ReadFile(const fs::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        throw std::runtime_error("Failed to read static file " + path.string());
+
+    auto content = std::make_shared<std::string>();
+    content->resize(fs::file_size(path));
+    file.read(content->data(), static_cast<std::streamsize>(content->size()));
+    content->resize(static_cast<size_t>(file.gcount()));
+    return content;
+}
+
+std::string FormatHttpDate(fs::file_time_type time) {
+    const auto sys_time = std::chrono::time_point_cast<std::chrono::seconds>(std::chrono::file_clock::to_sys(time));
+    const std::time_t seconds = std::chrono::system_clock::to_time_t(sys_time);
+
+    std::tm tm{};
+    gmtime_r(&seconds, &tm);
+    char buffer[32];
+    const size_t size = std::strftime(buffer, sizeof(buffer), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    return std::string(buffer, size);
+}
+
+// ETag файла, который не хранится в памяти: по размеру и времени изменения
+std::string MakeFileETag(uint64_t size, fs::file_time_type time) {
+    std::stringstream etag;
+    etag << '"' << std::hex << size << '-' << time.time_since_epoch().count() << '"';
+    return etag.str();
+}
+
+}  // namespace
+
+StaticFileCache::StaticFileCache(const fs::path& root) {
+    for (const auto& entry : fs::recursive_directory_iterator(root)) {
+        if (entry.is_symlink() || !entry.is_regular_file())
+            continue;
+
+        const auto& path = entry.path();
+        StaticFile file;
+        file.path = path;
+        file.size = entry.file_size();
+
+        const std::string extension = path.extension().string();
+        file.content_type = extension.empty() ? MimeType::UNKNOWN : utils::GetMimeType(std::string_view(extension).substr(1));
+
+        const auto write_time = entry.last_write_time();
+        file.last_modified = FormatHttpDate(write_time);
+        if (file.size <= MAX_CACHED_SIZE) {
+            file.body = ReadFile(path);
+            file.size = file.body->size();
+            file.etag = MakeETag(*file.body);
+        } else {
+            file.etag = MakeFileETag(file.size, write_time);
+        }
+
+        files_.emplace("/" + fs::relative(path, root).generic_string(), std::move(file));
+    }
+
+    // Сжатые варианты привязываются к исходным файлам, но остаются доступны и по своему имени
+    for (auto& [key, file] : files_) {
+        const std::string_view name = key;
+        const bool is_gzip = name.ends_with(GZIP_SUFFIX);
+        if (!is_gzip && !name.ends_with(BROTLI_SUFFIX))
+            continue;
+        if (file.size > MAX_CACHED_SIZE)
+            continue;
+
+        const auto original = files_.find(name.substr(0, name.size() - (is_gzip ? GZIP_SUFFIX : BROTLI_SUFFIX).size()));
+        if (original == files_.end())
+            continue;
+
+        auto& target = original->second;
+        (is_gzip ? target.gzip : target.brotli) = file.body;
+        (is_gzip ? target.gzip_etag : target.brotli_etag) = MakeVariantETag(target.etag, is_gzip ? "gz"sv : "br"sv);
+    }
+}
+
+const StaticFile* StaticFileCache::Find(std::string_view target) const {
+    target = target.substr(0, target.find('?'));
+
+    const size_t last_slash = target.rfind('/');
+    if (last_slash == std::string_view::npos || target.find('.', last_slash) == std::string_view::npos)
+        target = INDEX;
+
+    if (const auto it = files_.find(target); it != files_.end())
+        return &it->second;
+    return nullptr;
+}
+
+}  // namespace http_handler
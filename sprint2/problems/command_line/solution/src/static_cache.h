@@ -0,0 +1,76 @@
+#pragma once
+
+#include "handler_utils.h"
+#include "shared_body.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace http_handler {
+
+namespace fs = std::filesystem;
+
+// Файл каталога статического контента
+struct StaticFile {
+    using Body = http_server::SharedStringBody::value_type;
+
+    fs::path path;
+    std::string_view content_type;
+    uint64_t size = 0;
+    std::string etag;
+    // Время изменения в формате даты HTTP, для заголовка Last-Modified
+    std::string last_modified;
+    // Содержимое файла. Пусто у файлов больше StaticFileCache::MAX_CACHED_SIZE:
+    // они читаются с диска при каждой отправке
+    Body body;
+    // Заранее сжатые варианты из файлов <имя>.gz и <имя>.br рядом с оригиналом
+    Body gzip;
+    Body brotli;
+    // ETag сжатых вариантов: "<etag>-gz" и "<etag>-br"
+    std::string gzip_etag;
+    std::string brotli_etag;
+
+    // Размер, от которого считаются диапазоны. У файла в памяти - размер прочитанного содержимого:
+    // файл мог измениться между получением размера и чтением
+    uint64_t GetSize() const noexcept { return body ? body->size() : size; }
+};
+
+// Заголовки запроса, от которых зависит ответ со статическим файлом
+struct StaticFileRequest {
+    std::string_view if_none_match;
+    std::string_view accept_encoding;
+    std::string_view range;
+    std::string_view if_range;
+    bool is_head_method = false;
+};
+
+// Кеш каталога статического контента (--www-root), заполняемый при запуске сервера.
+// Содержимое небольших файлов хранится в памяти и отправляется без копирования.
+// Проверка пути запроса сводится к поиску в таблице: в неё попадают только обычные
+// файлы внутри корня, символические ссылки пропускаются. Изменения файлов после запуска
+// не отслеживаются
+class StaticFileCache {
+public:
+    static constexpr uint64_t MAX_CACHED_SIZE = 1024 * 1024;
+
+    explicit StaticFileCache(const fs::path& root);
+
+    // Файл по раскодированной цели запроса. Путь без расширения в последнем фрагменте
+    // ведёт на /index.html. nullptr, если такого файла нет
+    const StaticFile* Find(std::string_view target) const;
+
+    size_t GetFileCount() const noexcept { return files_.size(); }
+
+private:
+    struct StringHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view str) const { return std::hash<std::string_view>{}(str); }
+    };
+
+    std::unordered_map<std::string, StaticFile, StringHash, std::equal_to<>> files_;
+};
+
+}  // namespace http_handler
@@ -0,0 +1,190 @@
+#include "tracer.h"
+
+#include <atomic>
+#include <charconv>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace http_server {
+
+using namespace std::literals;
+
+namespace {
+
+// Имена интервалов по этапу, с которого они начинаются
+constexpr std::array<std::string_view, RequestTrace::STAGE_COUNT> STAGE_SPANS = {
+    "decode"sv, "handler"sv, "strand_wait"sv, "strand_handler"sv, "write_queue"sv, "write"sv, {}
+};
+
+struct TraceRecord {
+    uint64_t id = 0;
+    std::string name;
+    std::array<int64_t, RequestTrace::STAGE_COUNT> marks{};
+};
+
+// Кольцевой буфер потока. Пишет только его поток, мьютекс нужен для вывода и
+// поэтому почти никогда не захватывается конкурентно
+struct TraceRing {
+    explicit TraceRing(size_t thread)
+        : thread(thread) {
+        records.resize(Tracer::RING_CAPACITY);
+    }
+
+    std::mutex mutex;
+    std::vector<TraceRecord> records;
+    size_t next = 0;
+    size_t size = 0;
+    const size_t thread;
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<TraceRing>> rings;
+};
+
+Registry& GetRegistry() {
+    static Registry registry;
+    return registry;
+}
+
+TraceRing& LocalRing() {
+    thread_local TraceRing* local = [] {
+        auto& registry = GetRegistry();
+        std::lock_guard lock(registry.mutex);
+        return registry.rings.emplace_back(std::make_unique<TraceRing>(registry.rings.size())).get();
+    }();
+    return *local;
+}
+
+std::atomic<unsigned> sample_rate{0};
+std::atomic<uint64_t> next_trace_id{1};
+thread_local TracePtr current_trace;
+
+void AppendInt(std::string& out, uint64_t value) {
+    char buffer[24];
+    const auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, end);
+}
+
+// Время в микросекундах с точностью до наносекунд, как принято в trace-event
+void AppendMicros(std::string& out, int64_t nanos) {
+    AppendInt(out, static_cast<uint64_t>(nanos / 1000));
+    out += '.';
+    const auto fraction = static_cast<unsigned>(nanos % 1000);
+    out += static_cast<char>('0' + fraction / 100);
+    out += static_cast<char>('0' + fraction / 10 % 10);
+    out += static_cast<char>('0' + fraction % 10);
+}
+
+// Асинхронное событие начала или конца интервала. События с одним id и категорией
+// вложены друг в друга, поэтому этапы отображаются внутри интервала запроса
+void AppendEvent(std::string& out, char phase, std::string_view name, uint64_t id, int64_t nanos, size_t thread) {
+    if (out.back() != '[')
+        out += ',';
+    out += "{\"name\":\""sv;
+    out += name;
+    out += "\",\"cat\":\"request\",\"ph\":\""sv;
+    out += phase;
+    out += "\",\"id\":"sv;
+    AppendInt(out, id);
+    out += ",\"ts\":"sv;
+    AppendMicros(out, nanos);
+    out += ",\"pid\":1,\"tid\":"sv;
+    AppendInt(out, thread);
+    out += '}';
+}
+
+void AppendRecord(std::string& out, const TraceRecord& record, size_t thread) {
+    const auto& marks = record.marks;
+    const int64_t start = marks[static_cast<size_t>(TraceStage::READ)];
+    const int64_t end = marks[static_cast<size_t>(TraceStage::DONE)];
+    if (start == 0 || end == 0)
+        return;
+
+    AppendEvent(out, 'b', record.name, record.id, start, thread);
+    for (size_t stage = 0; stage + 1 < RequestTrace::STAGE_COUNT; ++stage) {
+        if (marks[stage] == 0)
+            continue;
+        // Интервал этапа длится до следующего отмеченного этапа
+        size_t next = stage + 1;
+        while (marks[next] == 0)
+            ++next;
+        AppendEvent(out, 'b', STAGE_SPANS[stage], record.id, marks[stage], thread);
+        AppendEvent(out, 'e', STAGE_SPANS[stage], record.id, marks[next], thread);
+    }
+    AppendEvent(out, 'e', record.name, record.id, end, thread);
+}
+
+}  // namespace
+
+void RequestTrace::SetName(std::string_view name) {
+    name_.assign(name.substr(0, MAX_NAME));
+    for (char& c : name_) {
+        if (c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20)
+            c = '_';
+    }
+}
+
+void Tracer::SetSampleRate(unsigned every_nth) noexcept {
+    sample_rate.store(every_nth, std::memory_order_relaxed);
+}
+
+TracePtr Tracer::Sample() {
+    const unsigned rate = sample_rate.load(std::memory_order_relaxed);
+    if (rate == 0)
+        return nullptr;
+
+    thread_local unsigned counter = 0;
+    if (++counter < rate)
+        return nullptr;
+    counter = 0;
+
+    auto trace = std::make_shared<RequestTrace>(next_trace_id.fetch_add(1, std::memory_order_relaxed));
+    trace->Mark(TraceStage::READ);
+    return trace;
+}
+
+const TracePtr& Tracer::Current() noexcept {
+    return current_trace;
+}
+
+void Tracer::Finish(const RequestTrace& trace) {
+    auto& ring = LocalRing();
+    std::lock_guard lock(ring.mutex);
+    auto& record = ring.records[ring.next];
+    record.id = trace.GetId();
+    record.name.assign(trace.GetName());
+    for (size_t stage = 0; stage < RequestTrace::STAGE_COUNT; ++stage)
+        record.marks[stage] = trace.GetMark(static_cast<TraceStage>(stage));
+
+    ring.next = (ring.next + 1) % RING_CAPACITY;
+    if (ring.size < RING_CAPACITY)
+        ++ring.size;
+}
+
+void Tracer::WriteChromeTrace(std::string& out) {
+    out += "{\"traceEvents\":["sv;
+
+    auto& registry = GetRegistry();
+    std::lock_guard registry_lock(registry.mutex);
+    for (const auto& ring : registry.rings) {
+        std::lock_guard lock(ring->mutex);
+        // От старых записей к новым
+        const size_t first = (ring->next + RING_CAPACITY - ring->size) % RING_CAPACITY;
+        for (size_t i = 0; i < ring->size; ++i)
+            AppendRecord(out, ring->records[(first + i) % RING_CAPACITY], ring->thread);
+    }
+
+    out += "],\"displayTimeUnit\":\"ms\"}"sv;
+}
+
+Tracer::Scope::Scope(TracePtr trace) noexcept
+    : previous_(std::exchange(current_trace, std::move(trace))) {
+}
+
+Tracer::Scope::~Scope() {
+    current_trace = std::move(previous_);
+}
+
+}  // namespace http_server
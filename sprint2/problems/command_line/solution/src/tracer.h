@@ -0,0 +1,110 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace http_server {
+
+// Этапы обработки запроса в порядке их прохождения. Этапы QUEUED и HANDLER есть
+// только у запросов, выполняемых в strand игровой сессии
+enum class TraceStage : uint8_t {
+    // Запрос прочитан из сокета
+    READ,
+    // Цель запроса раскодирована, выбран обработчик
+    ROUTED,
+    // Задача поставлена в strand сессии
+    QUEUED,
+    // Задача начала выполняться в strand
+    HANDLER,
+    // Ответ сформирован и передан сессии
+    RESPONSE,
+    // Начата запись ответа: предыдущие ответы соединения отправлены
+    WRITE,
+    // Ответ записан в сокет
+    DONE,
+    COUNT
+};
+
+// Отметки времени этапов одного запроса. Этапы отмечаются в разных потоках, но
+// последовательно, поэтому отметки хранятся без атомарных операций. Для этого трасса
+// передаётся только одной задаче за раз: между отметками есть передача через executor.
+// Задачи, которые выполняются параллельно (например, тик в strand всех сессий),
+// трассу запроса не получают
+class RequestTrace {
+public:
+    static constexpr size_t STAGE_COUNT = static_cast<size_t>(TraceStage::COUNT);
+    static constexpr size_t MAX_NAME = 64;
+
+    explicit RequestTrace(uint64_t id) noexcept
+        : id_(id) {
+    }
+
+    void Mark(TraceStage stage) noexcept {
+        marks_[static_cast<size_t>(stage)] = Now();
+    }
+
+    // Имя трассы - цель запроса. Длинные цели обрезаются, кавычки и управляющие символы заменяются
+    void SetName(std::string_view name);
+
+    uint64_t GetId() const noexcept { return id_; }
+    std::string_view GetName() const noexcept { return name_; }
+    // Наносекунды монотонных часов, 0 - этап не отмечен
+    int64_t GetMark(TraceStage stage) const noexcept { return marks_[static_cast<size_t>(stage)]; }
+
+private:
+    static int64_t Now() noexcept {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    uint64_t id_;
+    std::string name_;
+    std::array<int64_t, STAGE_COUNT> marks_{};
+};
+
+using TracePtr = std::shared_ptr<RequestTrace>;
+
+// Выборочная трассировка запросов. Трассируется каждый N-й запрос потока, по умолчанию
+// трассировка выключена. Завершённые трассы попадают в кольцевой буфер потока, где
+// старые записи вытесняются новыми, и выводятся по запросу в формате Chrome trace-event
+// (chrome://tracing, Perfetto). Текущая трасса передаётся обработчикам через переменную
+// потока: её устанавливает Scope, а при переходе в другой strand трассу переносит
+// вызывающий код
+class Tracer {
+public:
+    // Записей в кольцевом буфере каждого потока
+    static constexpr size_t RING_CAPACITY = 1024;
+
+    Tracer() = delete;
+
+    // 0 выключает трассировку
+    static void SetSampleRate(unsigned every_nth) noexcept;
+    // Новая трасса, если запрос попал в выборку, иначе nullptr
+    static TracePtr Sample();
+    // Трасса запроса, который обрабатывается в этом потоке, или nullptr
+    static const TracePtr& Current() noexcept;
+    // Сохраняет завершённую трассу в буфер потока
+    static void Finish(const RequestTrace& trace);
+
+    // Трассы всех потоков в формате JSON {"traceEvents":[...]}
+    static void WriteChromeTrace(std::string& out);
+
+    // Делает trace текущей трассой потока до конца области видимости
+    class Scope {
+    public:
+        explicit Scope(TracePtr trace) noexcept;
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        TracePtr previous_;
+    };
+};
+
+}  // namespace http_server
@@ -0,0 +1,202 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdlib>
+#include <new>
+
+#include "../src/api_handler.h"
+
+using namespace std::literals;
+using namespace http_handler;
+
+// Счётчик обращений к куче: тела запросов должны разбираться в JsonArena
+static size_t heap_allocations = 0;
+
+void* operator new(std::size_t size) {
+    ++heap_allocations;
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+
+using Request = http::request<http::string_body>;
+
+struct Response {
+    http::status status;
+    std::string body;
+    // Трасса, текущая в момент отправки ответа
+    const http_server::RequestTrace* trace = nullptr;
+};
+
+// Сохраняет отправленные ответы в порядке отправки
+struct RecordingSend {
+    std::vector<Response>* responses;
+
+    template <typename Body, typename Fields>
+    void operator()(http::response<Body, Fields>& response) const {
+        Response recorded{response.result(), {}, http_server::Tracer::Current().get()};
+        if constexpr (std::is_same_v<Body, http::string_body>)
+            recorded.body = response.body();
+        else if constexpr (std::is_same_v<Body, http_server::SharedStringBody>)
+            recorded.body = response.body() ? *response.body() : std::string{};
+        responses->push_back(std::move(recorded));
+    }
+};
+
+model::Game MakeGame() {
+    model::Map map{model::Map::Id{"map1"s}, "Map 1"s};
+    map.AddRoad({model::Road::HORIZONTAL, {0, 0}, 40});
+    map.SetSpeed(1.);
+    model::Game game;
+    game.AddMap(std::move(map));
+    return game;
+}
+
+// Обработчик API с ручными тиками. Задачи strand выполняются в RunTasks
+struct Server {
+    net::io_context ioc;
+    ResponseCompressor compressor;
+    app::Application app{MakeGame(), false};
+    std::shared_ptr<APIHandler> handler = std::make_shared<APIHandler>(app, ioc, true, compressor);
+    std::vector<Response> responses;
+
+    void Handle(Request req, bool after_pending = false) {
+        std::string decoded_target;
+        const auto route = ApiRouter::Match(DecodeTarget(req.target(), decoded_target), req.method());
+        handler->HandleRequest(route, std::move(req), RecordingSend{&responses}, [](ResponseData&&) {}, after_pending);
+    }
+
+    void RunTasks() {
+        ioc.restart();
+        ioc.run();
+    }
+};
+
+Request MakePost(std::string_view target, std::string body) {
+    Request req{http::verb::post, target, 11};
+    req.set(http::field::content_type, MimeType::APP_JSON);
+    req.body() = std::move(body);
+    req.prepare_payload();
+    return req;
+}
+
+Request MakeGet(std::string_view target, std::string_view token) {
+    Request req{http::verb::get, target, 11};
+    req.set(http::field::authorization, "Bearer "s + std::string{token});
+    return req;
+}
+
+// Массив из count небольших объектов: разобранный, он помещается в буфер JsonArena
+std::string MakePadding(size_t count) {
+    std::string padding = "["s;
+    for (size_t i = 0; i < count; ++i) {
+        if (i != 0)
+            padding += ',';
+        padding += R"({"x":)" + std::to_string(i) + "}";
+    }
+    padding += ']';
+    return padding;
+}
+
+// Число обращений к куче при обработке запроса. Первый вызов прогревает буфер арены и кеши
+size_t CountAllocations(Server& server, const Request& req) {
+    server.Handle(req);
+    Request copy = req;
+    const size_t before = heap_allocations;
+    server.Handle(std::move(copy));
+    return heap_allocations - before;
+}
+
+// Одинаковый ответ на запрос с лишним полем pad и без него. Если разобранное тело
+// копируется из арены в кучу, каждый объект pad добавляет обращение к куче
+void CheckBodyStaysInArena(std::string_view target, std::string_view body_prefix, std::string_view body_suffix) {
+    Server server;
+    const auto plain = MakePost(target, std::string{body_prefix} + std::string{body_suffix});
+    const auto padded = MakePost(target, std::string{body_prefix} + R"(,"pad":)" + MakePadding(100) + std::string{body_suffix});
+
+    const size_t plain_allocations = CountAllocations(server, plain);
+    const size_t padded_allocations = CountAllocations(server, padded);
+    CHECK(padded_allocations == plain_allocations);
+
+    REQUIRE(server.responses.size() == 4);
+    CHECK(server.responses[1].status == server.responses[3].status);
+    CHECK(server.responses[1].body == server.responses[3].body);
+}
+
+}  // namespace
+
+TEST_CASE("Join body is parsed without heap copies", "[APIHandler]") {
+    CheckBodyStaysInArena("/api/v1/game/join"sv, R"({"userName":"dog","mapId":"unknown")"sv, "}"sv);
+}
+
+TEST_CASE("Batch actions body is parsed without heap copies", "[APIHandler]") {
+    CheckBodyStaysInArena("/api/v1/game/player/actions"sv,
+                          R"([{"token":"0123456789abcdef0123456789abcdef","move":"U")"sv, "}]"sv);
+}
+
+TEST_CASE("Tick body is parsed without heap copies", "[APIHandler]") {
+    CheckBodyStaysInArena("/api/v1/game/tick"sv, R"({"timeDelta":0)"sv, "}"sv);
+}
+
+TEST_CASE("Pipelined state read sees the preceding action", "[APIHandler]") {
+    Server server;
+    server.Handle(MakePost("/api/v1/game/join"sv, R"({"userName":"dog","mapId":"map1"})"s));
+    server.RunTasks();
+    REQUIRE(server.responses.size() == 1);
+    const std::string token{json::parse(server.responses[0].body).as_object().at("authToken").as_string().c_str()};
+
+    // Состояние со стоящей собакой попадает в кеш
+    server.Handle(MakeGet("/api/v1/game/state"sv, token));
+    server.RunTasks();
+    REQUIRE(server.responses.size() == 2);
+
+    // Действие и чтение состояния приходят одним пакетом: действие ждёт в strand сессии
+    auto action = MakePost("/api/v1/game/player/action"sv, R"({"move":"R"})"s);
+    action.set(http::field::authorization, "Bearer "s + token);
+    server.Handle(std::move(action));
+    server.Handle(MakeGet("/api/v1/game/state"sv, token), true);
+    CHECK(server.responses.size() == 2);
+
+    server.RunTasks();
+    REQUIRE(server.responses.size() == 4);
+    CHECK(server.responses[2].status == http::status::ok);
+    CHECK(server.responses[3].status == http::status::ok);
+    const auto state = json::parse(server.responses[3].body);
+    const auto& dog = state.as_object().at("players").as_object().begin()->value().as_object();
+    CHECK(dog.at("speed").as_array().at(0).as_double() == 1.0);
+    CHECK(dog.at("dir").as_string() == "R"sv);
+
+    // Без незавершённых запросов соединения состояние отдаётся из кеша сразу
+    server.Handle(MakeGet("/api/v1/game/state"sv, token));
+    REQUIRE(server.responses.size() == 5);
+    CHECK(server.responses[4].body == server.responses[3].body);
+}
+
+TEST_CASE("Tick trace is not shared with session strands", "[APIHandler]") {
+    Server server;
+    server.Handle(MakePost("/api/v1/game/join"sv, R"({"userName":"dog","mapId":"map1"})"s));
+    server.RunTasks();
+
+    auto trace = std::make_shared<http_server::RequestTrace>(1);
+    {
+        http_server::Tracer::Scope scope(trace);
+        server.Handle(MakePost("/api/v1/game/tick"sv, R"({"timeDelta":10})"s));
+    }
+    server.RunTasks();
+
+    REQUIRE(server.responses.size() == 2);
+    CHECK(server.responses[1].status == http::status::ok);
+    // Задачи тика в strand сессий трассу не получают, а ответ отправляется уже с ней
+    CHECK(trace->GetMark(http_server::TraceStage::QUEUED) == 0);
+    CHECK(trace->GetMark(http_server::TraceStage::HANDLER) == 0);
+    CHECK(server.responses[1].trace == trace.get());
+}
@@ -0,0 +1,106 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/api_router.h"
+
+using namespace std::literals;
+using boost::beast::http::verb;
+using http_handler::ApiRoute;
+using http_handler::ApiRouter;
+using http_handler::DecodeTarget;
+
+TEST_CASE("Routes are matched by path", "[ApiRouter]") {
+    CHECK(ApiRouter::Match("/api/v1/maps"sv, verb::get).route == ApiRoute::MAP_LIST);
+    CHECK(ApiRouter::Match("/api/v1/maps/map1"sv, verb::get).route == ApiRoute::MAP);
+    CHECK(ApiRouter::Match("/api/v1/map/map1"sv, verb::get).route == ApiRoute::MAP);
+    CHECK(ApiRouter::Match("/api/v1/game/join"sv, verb::post).route == ApiRoute::JOIN);
+    CHECK(ApiRouter::Match("/api/v1/game/players"sv, verb::get).route == ApiRoute::PLAYERS);
+    CHECK(ApiRouter::Match("/api/v1/game/state"sv, verb::get).route == ApiRoute::STATE);
+    CHECK(ApiRouter::Match("/api/v1/game/player/action"sv, verb::post).route == ApiRoute::ACTION);
+    CHECK(ApiRouter::Match("/api/v1/game/player/actions"sv, verb::post).route == ApiRoute::ACTIONS);
+    CHECK(ApiRouter::Match("/api/v1/game/tick"sv, verb::post).route == ApiRoute::TICK);
+}
+
+TEST_CASE("Path parameter and query are returned", "[ApiRouter]") {
+    const auto map = ApiRouter::Match("/api/v1/maps/town center"sv, verb::get);
+    CHECK(map.param == "town center"sv);
+    CHECK(map.query.empty());
+
+    const auto state = ApiRouter::Match("/api/v1/game/state?since=42"sv, verb::get);
+    CHECK(state.route == ApiRoute::STATE);
+    CHECK(state.query == "since=42"sv);
+
+    const auto map_with_query = ApiRouter::Match("/api/v1/maps/map1?x=1"sv, verb::get);
+    CHECK(map_with_query.param == "map1"sv);
+    CHECK(map_with_query.query == "x=1"sv);
+}
+
+TEST_CASE("Unknown paths are not found", "[ApiRouter]") {
+    CHECK(ApiRouter::Match("/api/v2/maps"sv, verb::get).route == ApiRoute::NOT_FOUND);
+    CHECK(ApiRouter::Match("/api/v1/"sv, verb::get).route == ApiRoute::NOT_FOUND);
+    CHECK(ApiRouter::Match("/api/v1/maps/"sv, verb::get).route == ApiRoute::NOT_FOUND);
+    CHECK(ApiRouter::Match("/api/v1/maps/map1/roads"sv, verb::get).route == ApiRoute::NOT_FOUND);
+    CHECK(ApiRouter::Match("/api/v1/game"sv, verb::get).route == ApiRoute::NOT_FOUND);
+    CHECK(ApiRouter::Match("/api/v1/game/player"sv, verb::post).route == ApiRoute::NOT_FOUND);
+    CHECK(ApiRouter::Match("/api/v1/game/player/action/1"sv, verb::post).route == ApiRoute::NOT_FOUND);
+    CHECK(ApiRouter::Match("/api/v1/game/State"sv, verb::get).route == ApiRoute::NOT_FOUND);
+    CHECK(ApiRouter::Match("/api/v1/game/state/"sv, verb::get).route == ApiRoute::NOT_FOUND);
+}
+
+TEST_CASE("Method not allowed carries the Allow value", "[ApiRouter]") {
+    struct Case {
+        std::string_view target;
+        verb allowed;
+        verb rejected;
+        std::string_view allow;
+    };
+    const Case cases[] = {
+        {"/api/v1/game/join"sv, verb::post, verb::get, "POST"sv},
+        {"/api/v1/game/players"sv, verb::get, verb::post, "GET, HEAD"sv},
+        {"/api/v1/game/state"sv, verb::head, verb::delete_, "GET, HEAD"sv},
+        {"/api/v1/game/player/action"sv, verb::post, verb::put, "POST"sv},
+        {"/api/v1/game/player/actions"sv, verb::post, verb::get, "POST"sv},
+        {"/api/v1/game/tick"sv, verb::post, verb::head, "POST"sv},
+    };
+
+    for (const auto& c : cases) {
+        INFO("target: " << c.target);
+        CHECK(ApiRouter::Match(c.target, c.allowed).method_allowed);
+
+        const auto rejected = ApiRouter::Match(c.target, c.rejected);
+        CHECK(rejected.route != ApiRoute::NOT_FOUND);
+        CHECK_FALSE(rejected.method_allowed);
+        CHECK(rejected.allow == c.allow);
+    }
+
+    // Карты отдаются любым методом
+    CHECK(ApiRouter::Match("/api/v1/maps"sv, verb::post).method_allowed);
+    CHECK(ApiRouter::Match("/api/v1/maps/map1"sv, verb::delete_).method_allowed);
+}
+
+TEST_CASE("Target without escapes is not copied", "[DecodeTarget]") {
+    std::string buffer;
+    const auto target = "/api/v1/maps/map1?since=1"sv;
+    const auto decoded = DecodeTarget(target, buffer);
+    CHECK(decoded == target);
+    CHECK(decoded.data() == target.data());
+    CHECK(buffer.empty());
+}
+
+TEST_CASE("Percent escapes and plus are decoded", "[DecodeTarget]") {
+    std::string buffer;
+    CHECK(DecodeTarget("/maps/town%20center"sv, buffer) == "/maps/town center"sv);
+    CHECK(DecodeTarget("/a%2fb%2Fc"sv, buffer) == "/a/b/c"sv);
+    CHECK(DecodeTarget("/%41%7a"sv, buffer) == "/Az"sv);
+    CHECK(DecodeTarget("/town+center"sv, buffer) == "/town center"sv);
+    CHECK(DecodeTarget("/%2B+"sv, buffer) == "/+ "sv);
+    CHECK(DecodeTarget("/%D0%BA"sv, buffer) == "/\xD0\xBA"sv);
+}
+
+TEST_CASE("Malformed escapes are kept as is", "[DecodeTarget]") {
+    std::string buffer;
+    CHECK(DecodeTarget("/a%zzb"sv, buffer) == "/a%zzb"sv);
+    CHECK(DecodeTarget("/a%2gb"sv, buffer) == "/a%2gb"sv);
+    CHECK(DecodeTarget("/a%"sv, buffer) == "/a%"sv);
+    CHECK(DecodeTarget("/a%2"sv, buffer) == "/a%2"sv);
+    CHECK(DecodeTarget("/%%41"sv, buffer) == "/%A"sv);
+}
@@ -0,0 +1,150 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <thread>
+#include <vector>
+
+#include "../src/buffer_pool.h"
+
+using http_server::BufferPool;
+
+namespace {
+
+struct StatsDelta {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+};
+
+// Изменение счётчиков пула за время выполнения f
+template <typename F>
+StatsDelta Measure(F&& f) {
+    const auto before = BufferPool::GetStats();
+    f();
+    const auto after = BufferPool::GetStats();
+    return { after.hits - before.hits, after.misses - before.misses };
+}
+
+// Списки свободных блоков у каждого потока свои: в новом потоке они пусты.
+// Проверки выполняются после join, в потоке теста
+template <typename F>
+void RunInNewThread(F&& f) {
+    std::thread thread{std::forward<F>(f)};
+    thread.join();
+}
+
+}  // namespace
+
+TEST_CASE("Freed block is reused on the same thread", "[BufferPool]") {
+    void* block = nullptr;
+    void* reused = nullptr;
+    StatsDelta first, second;
+    RunInNewThread([&] {
+        first = Measure([&] { block = BufferPool::Allocate(1000); });
+        BufferPool::Deallocate(block, 1000);
+        second = Measure([&] { reused = BufferPool::Allocate(1000); });
+        BufferPool::Deallocate(reused, 1000);
+    });
+
+    CHECK(first.misses == 1);
+    CHECK(first.hits == 0);
+    CHECK(reused == block);
+    CHECK(second.hits == 1);
+    CHECK(second.misses == 0);
+}
+
+TEST_CASE("Sizes are rounded up to a power of two class", "[BufferPool]") {
+    void* block = nullptr;
+    void* upper = nullptr;
+    void* lower = nullptr;
+    void* next_class = nullptr;
+    StatsDelta next_class_delta;
+    void* small = nullptr;
+    void* min_block = nullptr;
+    RunInNewThread([&] {
+        // 100 байт попадают в класс 128: блок подходит для любого размера от 65 до 128
+        block = BufferPool::Allocate(100);
+        BufferPool::Deallocate(block, 100);
+        upper = BufferPool::Allocate(128);
+        BufferPool::Deallocate(upper, 128);
+        lower = BufferPool::Allocate(65);
+        BufferPool::Deallocate(lower, 65);
+
+        // 129 байт - уже класс 256: свободный блок класса 128 ему не достаётся
+        next_class_delta = Measure([&] { next_class = BufferPool::Allocate(129); });
+        BufferPool::Deallocate(next_class, 129);
+
+        // Все размеры не больше MIN_BLOCK - один класс
+        small = BufferPool::Allocate(1);
+        BufferPool::Deallocate(small, 1);
+        min_block = BufferPool::Allocate(BufferPool::MIN_BLOCK);
+        BufferPool::Deallocate(min_block, BufferPool::MIN_BLOCK);
+    });
+
+    CHECK(upper == block);
+    CHECK(lower == block);
+    CHECK(next_class != block);
+    CHECK(next_class_delta.misses == 1);
+    CHECK(next_class_delta.hits == 0);
+    CHECK(min_block == small);
+}
+
+TEST_CASE("Blocks over MAX_BLOCK bypass the pool", "[BufferPool]") {
+    StatsDelta oversize, largest;
+    RunInNewThread([&] {
+        const size_t size = BufferPool::MAX_BLOCK + 1;
+        oversize = Measure([size] {
+            void* block = BufferPool::Allocate(size);
+            BufferPool::Deallocate(block, size);
+            block = BufferPool::Allocate(size);
+            BufferPool::Deallocate(block, size);
+        });
+
+        // Наибольший класс ещё обслуживается пулом
+        largest = Measure([] {
+            void* block = BufferPool::Allocate(BufferPool::MAX_BLOCK);
+            BufferPool::Deallocate(block, BufferPool::MAX_BLOCK);
+            block = BufferPool::Allocate(BufferPool::MAX_BLOCK);
+            BufferPool::Deallocate(block, BufferPool::MAX_BLOCK);
+        });
+    });
+
+    CHECK(oversize.hits == 0);
+    CHECK(oversize.misses == 2);
+    CHECK(largest.hits == 1);
+    CHECK(largest.misses == 1);
+}
+
+TEST_CASE("Free blocks of a class are limited per thread", "[BufferPool]") {
+    constexpr size_t kept = BufferPool::MAX_FREE_BYTES_PER_CLASS / BufferPool::MAX_BLOCK;
+    StatsDelta delta;
+    RunInNewThread([&] {
+        std::vector<void*> blocks(kept + 2);
+        for (auto& block : blocks)
+            block = BufferPool::Allocate(BufferPool::MAX_BLOCK);
+        for (void* block : blocks)
+            BufferPool::Deallocate(block, BufferPool::MAX_BLOCK);
+
+        // Сверх лимита блоки вернулись в кучу
+        delta = Measure([&blocks] {
+            for (auto& block : blocks)
+                block = BufferPool::Allocate(BufferPool::MAX_BLOCK);
+        });
+        for (void* block : blocks)
+            BufferPool::Deallocate(block, BufferPool::MAX_BLOCK);
+    });
+
+    CHECK(delta.hits == kept);
+    CHECK(delta.misses == 2);
+}
+
+TEST_CASE("Block freed on another thread joins that thread's list", "[BufferPool]") {
+    void* block = nullptr;
+    void* reused = nullptr;
+    RunInNewThread([&] { block = BufferPool::Allocate(1000); });
+    RunInNewThread([&] {
+        BufferPool::Deallocate(block, 1000);
+        reused = BufferPool::Allocate(1000);
+        BufferPool::Deallocate(reused, 1000);
+    });
+
+    CHECK(reused == block);
+}
@@ -0,0 +1,99 @@
+#include <catch2/catch_test_macros.hpp>
+#include <zlib.h>
+
+#include <random>
+#include <stdexcept>
+
+#include "../src/compression.h"
+
+using namespace std::literals;
+using http_handler::ContentEncoding;
+using http_handler::ResponseCompressor;
+
+namespace {
+
+// Распаковывает data средствами zlib. Для gzip к размеру окна прибавляется 16,
+// тогда zlib проверяет заголовок gzip, CRC-32 и длину, а для deflate - заголовок и Adler-32
+std::string Inflate(std::string_view data, ContentEncoding encoding) {
+    z_stream stream{};
+    const int window_bits = encoding == ContentEncoding::GZIP ? 15 + 16 : 15;
+    if (inflateInit2(&stream, window_bits) != Z_OK)
+        throw std::runtime_error("inflateInit2 failed");
+
+    std::string out;
+    char buffer[4096];
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    int result = Z_OK;
+    while (result == Z_OK) {
+        stream.next_out = reinterpret_cast<Bytef*>(buffer);
+        stream.avail_out = sizeof(buffer);
+        result = inflate(&stream, Z_NO_FLUSH);
+        out.append(buffer, sizeof(buffer) - stream.avail_out);
+    }
+    const bool consumed = stream.avail_in == 0;
+    inflateEnd(&stream);
+    if (result != Z_STREAM_END || !consumed)
+        throw std::runtime_error("inflate failed");
+    return out;
+}
+
+std::string MakeJson(size_t dogs) {
+    std::string json = R"({"players":{)";
+    for (size_t i = 0; i < dogs; ++i) {
+        if (i != 0)
+            json += ',';
+        json += R"(")" + std::to_string(i) + R"(":{"pos":[)" + std::to_string(i * 0.25) + ","
+            + std::to_string(i * 0.5) + R"(],"speed":[0.0,1.0],"dir":"U"})";
+    }
+    json += "}}";
+    return json;
+}
+
+std::string MakeRandom(size_t size) {
+    std::mt19937 generator{42};
+    std::uniform_int_distribution<int> byte{0, 255};
+    std::string data(size, '\0');
+    for (auto& c : data)
+        c = static_cast<char>(byte(generator));
+    return data;
+}
+
+}  // namespace
+
+TEST_CASE("Compressed bodies inflate back to the original", "[ResponseCompressor]") {
+    const std::string inputs[] = { ""s, "{}"s, MakeJson(1000), MakeRandom(100'000) };
+
+    for (const int level : { 1, ResponseCompressor::DEFAULT_LEVEL, 9 }) {
+        const ResponseCompressor compressor{level};
+        for (const auto encoding : { ContentEncoding::GZIP, ContentEncoding::DEFLATE }) {
+            for (const auto& input : inputs) {
+                INFO("level: " << level << ", encoding: " << ResponseCompressor::GetName(encoding) << ", size: " << input.size());
+                const std::string compressed = compressor.Compress(input, encoding);
+                CHECK(Inflate(compressed, encoding) == input);
+            }
+        }
+    }
+}
+
+TEST_CASE("Compression shrinks JSON bodies", "[ResponseCompressor]") {
+    const ResponseCompressor compressor;
+    const std::string json = MakeJson(1000);
+    CHECK(compressor.Compress(json, ContentEncoding::GZIP).size() < json.size() / 4);
+    CHECK(compressor.Compress(json, ContentEncoding::DEFLATE).size() < json.size() / 4);
+    CHECK(compressor.Compress(json, ContentEncoding::IDENTITY) == json);
+}
+
+TEST_CASE("Encoding is negotiated from Accept-Encoding", "[ResponseCompressor]") {
+    const ResponseCompressor compressor;
+    CHECK(compressor.Negotiate(""sv) == ContentEncoding::IDENTITY);
+    CHECK(compressor.Negotiate("br"sv) == ContentEncoding::IDENTITY);
+    CHECK(compressor.Negotiate("deflate, gzip"sv) == ContentEncoding::GZIP);
+    CHECK(compressor.Negotiate("gzip;q=0, deflate"sv) == ContentEncoding::DEFLATE);
+    CHECK(compressor.Negotiate("*"sv) == ContentEncoding::GZIP);
+    CHECK(compressor.Negotiate("*;q=0"sv) == ContentEncoding::IDENTITY);
+
+    const ResponseCompressor disabled{0};
+    CHECK(disabled.Negotiate("gzip"sv) == ContentEncoding::IDENTITY);
+    CHECK_FALSE(disabled.ShouldCompress(ResponseCompressor::MIN_SIZE));
+}
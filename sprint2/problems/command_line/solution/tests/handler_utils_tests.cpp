@@ -0,0 +1,138 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/handler_utils.h"
+
+using namespace std::literals;
+using http_handler::ByteRange;
+using http_handler::RangeParseResult;
+using http_handler::utils::AcceptsEncoding;
+using http_handler::utils::ParseRange;
+
+namespace {
+
+constexpr uint64_t SIZE = 1000;
+
+struct ParsedRange {
+    RangeParseResult result;
+    std::vector<ByteRange> ranges;
+};
+
+ParsedRange Parse(std::string_view range, uint64_t size = SIZE) {
+    ParsedRange parsed;
+    parsed.result = ParseRange(range, size, parsed.ranges);
+    return parsed;
+}
+
+}  // namespace
+
+namespace http_handler {
+
+bool operator==(const ByteRange& lhs, const ByteRange& rhs) {
+    return lhs.first == rhs.first && lhs.last == rhs.last;
+}
+
+}  // namespace http_handler
+
+TEST_CASE("Accept-Encoding lists the coding", "[AcceptsEncoding]") {
+    CHECK(AcceptsEncoding("gzip"sv, "gzip"sv));
+    CHECK(AcceptsEncoding("deflate, gzip"sv, "gzip"sv));
+    CHECK(AcceptsEncoding(" br ,  gzip ;q=0.5"sv, "gzip"sv));
+    CHECK(AcceptsEncoding("gzip;q=0.001"sv, "gzip"sv));
+
+    CHECK_FALSE(AcceptsEncoding(""sv, "gzip"sv));
+    CHECK_FALSE(AcceptsEncoding("deflate, br"sv, "gzip"sv));
+    CHECK_FALSE(AcceptsEncoding("x-gzip"sv, "gzip"sv));
+}
+
+TEST_CASE("Coding with q=0 is forbidden", "[AcceptsEncoding]") {
+    CHECK_FALSE(AcceptsEncoding("gzip;q=0"sv, "gzip"sv));
+    CHECK_FALSE(AcceptsEncoding("gzip; q=0.0"sv, "gzip"sv));
+    CHECK_FALSE(AcceptsEncoding("deflate, gzip;q=0.000"sv, "gzip"sv));
+    CHECK(AcceptsEncoding("gzip;q=0, deflate"sv, "deflate"sv));
+}
+
+TEST_CASE("Wildcard accepts codings that are not listed", "[AcceptsEncoding]") {
+    CHECK(AcceptsEncoding("*"sv, "gzip"sv));
+    CHECK(AcceptsEncoding("br;q=0, *"sv, "gzip"sv));
+    CHECK_FALSE(AcceptsEncoding("*;q=0"sv, "gzip"sv));
+
+    // Явно указанное кодирование важнее * в любом порядке
+    CHECK_FALSE(AcceptsEncoding("*, gzip;q=0"sv, "gzip"sv));
+    CHECK_FALSE(AcceptsEncoding("gzip;q=0, *"sv, "gzip"sv));
+    CHECK(AcceptsEncoding("*;q=0, gzip"sv, "gzip"sv));
+    CHECK(AcceptsEncoding("gzip, *;q=0"sv, "gzip"sv));
+}
+
+TEST_CASE("Missing or malformed Range is ignored", "[ParseRange]") {
+    CHECK(Parse(""sv).result == RangeParseResult::NONE);
+    CHECK(Parse("items=0-99"sv).result == RangeParseResult::NONE);
+    CHECK(Parse("bytes="sv).result == RangeParseResult::NONE);
+    CHECK(Parse("bytes=abc"sv).result == RangeParseResult::NONE);
+    CHECK(Parse("bytes=10"sv).result == RangeParseResult::NONE);
+    CHECK(Parse("bytes=99-0"sv).result == RangeParseResult::NONE);
+    // Один некорректный диапазон отменяет весь заголовок
+    CHECK(Parse("bytes=0-9,x-1"sv).result == RangeParseResult::NONE);
+}
+
+TEST_CASE("Closed ranges are clamped to the resource", "[ParseRange]") {
+    auto parsed = Parse("bytes=0-99"sv);
+    CHECK(parsed.result == RangeParseResult::SATISFIABLE);
+    CHECK(parsed.ranges == std::vector<ByteRange>{{0, 99}});
+
+    parsed = Parse("bytes=900-5000"sv);
+    CHECK(parsed.result == RangeParseResult::SATISFIABLE);
+    CHECK(parsed.ranges == std::vector<ByteRange>{{900, 999}});
+}
+
+TEST_CASE("Suffix ranges select the last bytes", "[ParseRange]") {
+    auto parsed = Parse("bytes=-100"sv);
+    CHECK(parsed.result == RangeParseResult::SATISFIABLE);
+    CHECK(parsed.ranges == std::vector<ByteRange>{{900, 999}});
+
+    parsed = Parse("bytes=-5000"sv);
+    CHECK(parsed.result == RangeParseResult::SATISFIABLE);
+    CHECK(parsed.ranges == std::vector<ByteRange>{{0, 999}});
+
+    CHECK(Parse("bytes=-0"sv).result == RangeParseResult::UNSATISFIABLE);
+    CHECK(Parse("bytes=-1"sv, 0).result == RangeParseResult::UNSATISFIABLE);
+}
+
+TEST_CASE("Open-ended ranges run to the end of the resource", "[ParseRange]") {
+    auto parsed = Parse("bytes=500-"sv);
+    CHECK(parsed.result == RangeParseResult::SATISFIABLE);
+    CHECK(parsed.ranges == std::vector<ByteRange>{{500, 999}});
+
+    parsed = Parse("bytes=999-"sv);
+    CHECK(parsed.ranges == std::vector<ByteRange>{{999, 999}});
+
+    CHECK(Parse("bytes=1000-"sv).result == RangeParseResult::UNSATISFIABLE);
+    CHECK(Parse("bytes=0-"sv, 0).result == RangeParseResult::UNSATISFIABLE);
+}
+
+TEST_CASE("Overlapping ranges are kept in header order", "[ParseRange]") {
+    auto parsed = Parse("bytes=0-99, 50-149"sv);
+    CHECK(parsed.result == RangeParseResult::SATISFIABLE);
+    CHECK(parsed.ranges == std::vector<ByteRange>{{0, 99}, {50, 149}});
+
+    parsed = Parse("bytes=900-,-50,0-0"sv);
+    CHECK(parsed.ranges == std::vector<ByteRange>{{900, 999}, {950, 999}, {0, 0}});
+
+    // Диапазоны за пределами ресурса отбрасываются, остальные обслуживаются
+    parsed = Parse("bytes=2000-3000,10-19"sv);
+    CHECK(parsed.result == RangeParseResult::SATISFIABLE);
+    CHECK(parsed.ranges == std::vector<ByteRange>{{10, 19}});
+}
+
+TEST_CASE("More than 16 ranges are ignored", "[ParseRange]") {
+    std::string range = "bytes=0-0"s;
+    for (int i = 1; i < 16; ++i)
+        range += ","s + std::to_string(i * 10) + "-"s + std::to_string(i * 10 + 1);
+
+    auto parsed = Parse(range);
+    CHECK(parsed.result == RangeParseResult::SATISFIABLE);
+    CHECK(parsed.ranges.size() == 16);
+
+    range += ",500-501"sv;
+    parsed = Parse(range);
+    CHECK(parsed.result == RangeParseResult::NONE);
+}
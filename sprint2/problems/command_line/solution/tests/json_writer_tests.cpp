@@ -0,0 +1,137 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <boost/json.hpp>
+
+#include <cmath>
+#include <limits>
+
+#include "../src/json_writer.h"
+
+using namespace std::literals;
+using http_handler::JsonWriter;
+namespace json = boost::json;
+namespace json_writer = http_handler::json_writer;
+
+namespace {
+
+std::string WriteDouble(double value) {
+    std::string out;
+    JsonWriter writer{out};
+    writer.Double(value);
+    return out;
+}
+
+std::string_view DirectionToString(model::Direction dir) {
+    switch (dir) {
+        case model::Direction::NORTH: return "U"sv;
+        case model::Direction::SOUTH: return "D"sv;
+        case model::Direction::EAST:  return "R"sv;
+        case model::Direction::WEST:  return "L"sv;
+    }
+    return {};
+}
+
+// Объект players, построенный через json::value, как до перехода на JsonWriter
+json::object DogsToJson(const std::vector<const model::Dog*>& dogs) {
+    json::object players;
+    for (const auto* dog : dogs) {
+        json::object dog_data;
+        const auto pos = dog->GetPosition();
+        dog_data["pos"] = json::array{ pos.x, pos.y };
+        const auto speed = dog->GetSpeed();
+        dog_data["speed"] = json::array{ speed.vx, speed.vy };
+        dog_data["dir"] = DirectionToString(dog->GetDirection());
+        players[std::to_string(dog->GetId())] = std::move(dog_data);
+    }
+    return players;
+}
+
+// Сессия с собаками в дробных координатах, бегущими в разные стороны
+struct SessionWithDogs {
+    model::Game game;
+    model::GameSession* session = nullptr;
+
+    SessionWithDogs() {
+        model::Map map{model::Map::Id{"map1"s}, "Map 1"s};
+        map.AddRoad({model::Road::HORIZONTAL, {0, 0}, 40});
+        map.AddRoad({model::Road::VERTICAL, {10, 0}, 30});
+        map.SetSpeed(1.3);
+        game.AddMap(std::move(map));
+        game.StartSessions(true);
+        session = &game.GetSessions().front();
+
+        const std::string names[] = { "Rex"s, "dog \"quoted\" \\ back"s, "tab\tnew\nline\x01"s, "\xD0\xBF\xD1\x91\xD1\x81"s };
+        int i = 0;
+        for (const auto& name : names) {
+            auto* dog = session->AddDog(model::Dog{std::string{name}});
+            dog->Move(static_cast<model::Direction>(i++ % 4), 1.3);
+        }
+        session->Tick(1234);
+    }
+};
+
+}  // namespace
+
+TEST_CASE("Doubles are written as json::serialize writes them", "[JsonWriter]") {
+    const double values[] = {
+        0.0, -0.0,
+        1.0, -1.0, 2.0, 10.0, 15.0, 100.0, 1e15, 1e16, 123456789.0,
+        1e21, -1e21, 1e22, 1e-7, 1e-6, 1.5e-7,
+        std::numeric_limits<double>::denorm_min(), -std::numeric_limits<double>::denorm_min(),
+        std::numeric_limits<double>::min() / 2, std::numeric_limits<double>::min(),
+        std::numeric_limits<double>::max(), std::numeric_limits<double>::epsilon(),
+        0.1, 0.4, 0.5, 1.3, 2.6, 12.345, 39.6, -0.4, 1234.5678, 1.0 / 3, 2.0 / 3,
+    };
+
+    for (const double value : values) {
+        INFO("value: " << value);
+        CHECK(WriteDouble(value) == json::serialize(json::value(value)));
+    }
+}
+
+TEST_CASE("Non-finite doubles are written as null", "[JsonWriter]") {
+    CHECK(WriteDouble(std::numeric_limits<double>::infinity()) == "null"s);
+    CHECK(WriteDouble(std::numeric_limits<double>::quiet_NaN()) == "null"s);
+}
+
+TEST_CASE("Strings are escaped as json::serialize escapes them", "[JsonWriter]") {
+    const std::string_view values[] = { ""sv, "plain"sv, "\"\\/"sv, "\b\f\n\r\t"sv, "\x01\x1f\x7f"sv, "\xD0\xBA"sv };
+    for (const auto value : values) {
+        std::string out;
+        JsonWriter writer{out};
+        writer.String(value);
+        CHECK(out == json::serialize(json::string(value)));
+    }
+}
+
+TEST_CASE("State and players documents match json::serialize", "[JsonWriter]") {
+    const SessionWithDogs session;
+    const auto dogs = session.session->GetDogs();
+    REQUIRE(dogs.size() == 4);
+
+    std::string state;
+    json_writer::WriteState(state, dogs);
+    json::object expected_state;
+    expected_state["players"] = DogsToJson(dogs);
+    CHECK(state == json::serialize(expected_state));
+
+    std::string delta;
+    json_writer::WriteStateDelta(delta, dogs, 42);
+    json::object expected_delta;
+    expected_delta["players"] = DogsToJson(dogs);
+    expected_delta["removed"] = json::array{};
+    expected_delta["tick"] = 42u;
+    CHECK(delta == json::serialize(expected_delta));
+
+    std::string players;
+    json_writer::WritePlayers(players, dogs);
+    json::object expected_players;
+    for (const auto* dog : dogs)
+        expected_players[std::to_string(dog->GetId())] = json::array{ "name", dog->GetName() };
+    CHECK(players == json::serialize(expected_players));
+
+    // Пустая сессия
+    std::string empty;
+    json_writer::WriteState(empty, {});
+    CHECK(empty == R"({"players":{}})"s);
+}
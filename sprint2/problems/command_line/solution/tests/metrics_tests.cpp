@@ -0,0 +1,113 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <string>
+
+#include "../src/metrics.h"
+
+using namespace std::literals;
+using http_handler::Metrics;
+using http_handler::MetricsRoute;
+using http_handler::MetricsWriter;
+using http_handler::ApiRoute;
+
+namespace {
+
+// Граница корзины в микросекундах
+double BoundMicros(size_t index) {
+    return Metrics::BucketBound(index) * 1e6;
+}
+
+}  // namespace
+
+TEST_CASE("Values up to one microsecond fall into the first bucket", "[Metrics]") {
+    CHECK(Metrics::BucketIndex(0) == 0);
+    CHECK(Metrics::BucketIndex(1) == 0);
+    CHECK(Metrics::BucketBound(0) == 1e-6);
+    // Октава (1, 2] мкс делится на SUB_BUCKETS корзин, 2 мкс - граница последней из них
+    CHECK(Metrics::BucketIndex(2) == Metrics::SUB_BUCKETS);
+}
+
+TEST_CASE("Bucket bounds grow and close each octave at a power of two", "[Metrics]") {
+    for (size_t i = 1; i + 1 < Metrics::BUCKETS; ++i) {
+        INFO("bucket: " << i);
+        CHECK(Metrics::BucketBound(i - 1) < Metrics::BucketBound(i));
+    }
+    for (size_t octave = 0; octave <= Metrics::MAX_OCTAVE; ++octave) {
+        INFO("octave: " << octave);
+        CHECK(BoundMicros(octave * Metrics::SUB_BUCKETS + Metrics::SUB_BUCKETS) == static_cast<double>(uint64_t{2} << octave));
+    }
+}
+
+TEST_CASE("Value lies between the previous and its own bucket bound", "[Metrics]") {
+    const auto check = [](uint64_t micros) {
+        const size_t index = Metrics::BucketIndex(micros);
+        INFO("micros: " << micros << ", bucket: " << index);
+        REQUIRE(index + 1 < Metrics::BUCKETS);
+        CHECK(static_cast<double>(micros) <= BoundMicros(index));
+        if (index != 0)
+            CHECK(BoundMicros(index - 1) < static_cast<double>(micros));
+    };
+
+    for (uint64_t micros = 0; micros <= 100'000; ++micros)
+        check(micros);
+    // Границы старших октав и соседние значения. Значения больше последней границы проверяются отдельно
+    const uint64_t last = uint64_t{2} << Metrics::MAX_OCTAVE;
+    for (size_t octave = 17; octave <= Metrics::MAX_OCTAVE; ++octave) {
+        const uint64_t base = uint64_t{1} << octave;
+        for (uint64_t sub = 0; sub <= Metrics::SUB_BUCKETS; ++sub) {
+            const uint64_t bound = base + base / Metrics::SUB_BUCKETS * sub;
+            check(bound - 1);
+            check(bound);
+            if (bound < last)
+                check(bound + 1);
+        }
+    }
+}
+
+TEST_CASE("Values over the last octave go to +Inf", "[Metrics]") {
+    const uint64_t last = uint64_t{2} << Metrics::MAX_OCTAVE;
+    CHECK(Metrics::BucketIndex(last) == Metrics::BUCKETS - 2);
+    CHECK(Metrics::BucketIndex(last + 1) == Metrics::BUCKETS - 1);
+    CHECK(Metrics::BucketIndex(UINT64_MAX) == Metrics::BUCKETS - 1);
+}
+
+TEST_CASE("Relative bucket width does not exceed 1 / SUB_BUCKETS", "[Metrics]") {
+    for (size_t i = 2; i + 1 < Metrics::BUCKETS; ++i) {
+        INFO("bucket: " << i);
+        const double width = BoundMicros(i) - BoundMicros(i - 1);
+        CHECK(width / BoundMicros(i - 1) <= 1.0 / Metrics::SUB_BUCKETS);
+    }
+}
+
+TEST_CASE("Label values are escaped and joined with commas", "[Metrics]") {
+    std::string labels;
+    MetricsWriter::AppendLabel(labels, "map"sv, "map1"sv);
+    CHECK(labels == R"(map="map1")"s);
+
+    MetricsWriter::AppendLabel(labels, "name"sv, "a\\b\"c\nd"sv);
+    CHECK(labels == R"(map="map1",name="a\\b\"c\nd")"s);
+
+    labels.clear();
+    MetricsWriter::AppendLabel(labels, "map"sv, ""sv);
+    CHECK(labels == R"(map="")"s);
+}
+
+TEST_CASE("Every API route has its own metrics route", "[Metrics]") {
+    CHECK(ToMetricsRoute(ApiRoute::NOT_FOUND) == MetricsRoute::API_NOT_FOUND);
+    CHECK(ToMetricsRoute(ApiRoute::MAP_LIST) == MetricsRoute::MAP_LIST);
+    CHECK(ToMetricsRoute(ApiRoute::MAP) == MetricsRoute::MAP);
+    CHECK(ToMetricsRoute(ApiRoute::JOIN) == MetricsRoute::JOIN);
+    CHECK(ToMetricsRoute(ApiRoute::PLAYERS) == MetricsRoute::PLAYERS);
+    CHECK(ToMetricsRoute(ApiRoute::STATE) == MetricsRoute::STATE);
+    CHECK(ToMetricsRoute(ApiRoute::ACTION) == MetricsRoute::ACTION);
+    CHECK(ToMetricsRoute(ApiRoute::ACTIONS) == MetricsRoute::ACTIONS);
+    CHECK(ToMetricsRoute(ApiRoute::TICK) == MetricsRoute::TICK);
+}
+
+TEST_CASE("Recorded request appears with route and code labels", "[Metrics]") {
+    Metrics::RecordRequest(MetricsRoute::TICK, boost::beast::http::status::ok, std::chrono::microseconds{3}, 10, 20);
+    std::string out;
+    Metrics::Render(out);
+    CHECK(out.find(R"(http_request_duration_seconds_bucket{route="tick",code="200",le="+Inf"} )") != std::string::npos);
+    CHECK(out.find(R"(http_request_duration_seconds_count{route="tick",code="200"} )") != std::string::npos);
+}
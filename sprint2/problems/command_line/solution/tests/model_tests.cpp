@@ -0,0 +1,200 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cmath>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "../src/model.h"
+
+using namespace std::literals;
+using model::Direction;
+using model::Position;
+using model::Speed;
+
+namespace {
+
+constexpr double DOG_SPEED = 1.0;
+constexpr double MAX_DELTA = 0.4;
+constexpr double TOLERANCE = 1e-6;
+
+struct Walk {
+    Direction direction;
+    unsigned duration;
+};
+
+Speed ToSpeed(Direction direction) {
+    switch (direction) {
+    case Direction::NORTH:
+        return {0., -DOG_SPEED};
+    case Direction::SOUTH:
+        return {0., DOG_SPEED};
+    case Direction::WEST:
+        return {-DOG_SPEED, 0.};
+    case Direction::EAST:
+        return {DOG_SPEED, 0.};
+    }
+    return {};
+}
+
+bool IsNearRoad(const model::Road& road, Position pos) {
+    const auto start = road.GetStart();
+    const auto end = road.GetEnd();
+    return pos.x >= std::min(start.x, end.x) - MAX_DELTA && pos.x <= std::max(start.x, end.x) + MAX_DELTA
+        && pos.y >= std::min(start.y, end.y) - MAX_DELTA && pos.y <= std::max(start.y, end.y) + MAX_DELTA;
+}
+
+// Перемещение собаки из исходной версии игры: учитываются только дороги клетки,
+// в которой собака стоит. При мелких тиках это эталон поведения собаки
+class BaselineMover {
+public:
+    explicit BaselineMover(const model::Map& map) {
+        for (const auto& road : map.GetRoads()) {
+            const auto start = road.GetStart();
+            const auto end = road.GetEnd();
+            if (road.IsHorizontal()) {
+                for (int x = std::min(start.x, end.x); x <= std::max(start.x, end.x); ++x)
+                    cells_[{x, start.y}].push_back(&road);
+            } else {
+                for (int y = std::min(start.y, end.y); y <= std::max(start.y, end.y); ++y)
+                    cells_[{start.x, y}].push_back(&road);
+            }
+        }
+    }
+
+    // Возвращает true, если собака упёрлась в границу дороги
+    bool Move(Position& pos, Speed speed, unsigned delta) const {
+        const double in_seconds = delta / 1000.0;
+        const Position end_pos{pos.x + speed.vx * in_seconds, pos.y + speed.vy * in_seconds};
+        const std::pair cell{static_cast<int>(std::round(pos.x)), static_cast<int>(std::round(pos.y))};
+
+        if (const auto it = cells_.find(cell); it != cells_.end()) {
+            for (const auto* road : it->second) {
+                if (IsNearRoad(*road, end_pos)) {
+                    pos = end_pos;
+                    return false;
+                }
+                const auto start = road->GetStart();
+                const auto end = road->GetEnd();
+                if (road->IsHorizontal() && speed.vy == 0.0) {
+                    pos.x = speed.vx > 0 ? std::max(start.x, end.x) + MAX_DELTA : std::min(start.x, end.x) - MAX_DELTA;
+                    return true;
+                }
+                if (road->IsVertical() && speed.vx == 0.0) {
+                    pos.y = speed.vy > 0 ? std::max(start.y, end.y) + MAX_DELTA : std::min(start.y, end.y) - MAX_DELTA;
+                    return true;
+                }
+            }
+        }
+
+        if (speed.vx == 0.0)
+            pos.y = cell.second + (speed.vy > 0 ? MAX_DELTA : -MAX_DELTA);
+        else
+            pos.x = cell.first + (speed.vx > 0 ? MAX_DELTA : -MAX_DELTA);
+        return true;
+    }
+
+private:
+    std::map<std::pair<int, int>, std::vector<const model::Road*>> cells_;
+};
+
+struct DogState {
+    Position position;
+    Speed speed;
+};
+
+DogState RunBaseline(const model::Map& map, const std::vector<Walk>& walks) {
+    const BaselineMover mover{map};
+    const auto start = map.GetRoads().front().GetStart();
+    DogState dog{{static_cast<double>(start.x), static_cast<double>(start.y)}, {}};
+
+    for (const auto& walk : walks) {
+        dog.speed = ToSpeed(walk.direction);
+        for (unsigned t = 0; t < walk.duration; ++t) {
+            if (dog.speed == Speed{})
+                break;
+            if (mover.Move(dog.position, dog.speed, 1))
+                dog.speed = {};
+        }
+    }
+    return dog;
+}
+
+// Проходит маршрут в сессии текущей модели тиками длиной не больше tick
+DogState RunSession(model::Map& map, const std::vector<Walk>& walks, unsigned tick) {
+    model::GameSession session{&map, false};
+    auto* dog = session.AddDog(model::Dog{"dog"s});
+
+    for (const auto& walk : walks) {
+        dog->Move(walk.direction, DOG_SPEED);
+        for (unsigned elapsed = 0; elapsed < walk.duration; elapsed += tick)
+            session.Tick(std::min(tick, walk.duration - elapsed));
+    }
+    return {dog->GetPosition(), dog->GetSpeed()};
+}
+
+// Карта с перекрёстками:
+//
+//  (0,0) ----------+---------- (20,0)
+//                  |              |
+//                  |              |
+//                (10,10) -------------------- (30,10)
+//
+// Вертикальная дорога x=10 идёт от y=-10 до y=10, x=20 - от y=0 до y=10
+model::Map MakeCrossroadsMap() {
+    model::Map map{model::Map::Id{"crossroads"s}, "Crossroads"s};
+    map.AddRoad({model::Road::HORIZONTAL, {0, 0}, 20});
+    map.AddRoad({model::Road::VERTICAL, {10, -10}, 10});
+    map.AddRoad({model::Road::VERTICAL, {20, 0}, 10});
+    map.AddRoad({model::Road::HORIZONTAL, {10, 10}, 30});
+    map.SetSpeed(DOG_SPEED);
+    map.BuildRoadIndex();
+    return map;
+}
+
+void CheckSameState(const DogState& actual, const DogState& expected) {
+    INFO("actual: (" << actual.position.x << ", " << actual.position.y << "), expected: ("
+         << expected.position.x << ", " << expected.position.y << ")");
+    CHECK(std::abs(actual.position.x - expected.position.x) < TOLERANCE);
+    CHECK(std::abs(actual.position.y - expected.position.y) < TOLERANCE);
+    CHECK(actual.speed == expected.speed);
+}
+
+void CheckTickIndependent(const std::vector<Walk>& walks) {
+    auto map = MakeCrossroadsMap();
+    const auto expected = RunBaseline(map, walks);
+    for (const unsigned tick : { 1u, 17u, 100u, 1'000'000u }) {
+        INFO("tick: " << tick << " ms");
+        CheckSameState(RunSession(map, walks, tick), expected);
+    }
+}
+
+}  // namespace
+
+TEST_CASE("Dog stops at the end of the road for any tick length", "[CalculateMove]") {
+    // Через перекрёсток x=10 до конца дороги
+    CheckTickIndependent({{Direction::EAST, 30'000}});
+    CheckTickIndependent({{Direction::WEST, 5'000}});
+    CheckTickIndependent({{Direction::EAST, 5'500}, {Direction::WEST, 20'000}});
+}
+
+TEST_CASE("Dog leaves a road only by the road width", "[CalculateMove]") {
+    CheckTickIndependent({{Direction::NORTH, 3'000}});
+    CheckTickIndependent({{Direction::EAST, 5'500}, {Direction::SOUTH, 3'000}});
+}
+
+TEST_CASE("Dog turns at crossroads for any tick length", "[CalculateMove]") {
+    CheckTickIndependent({{Direction::EAST, 10'000}, {Direction::SOUTH, 25'000}});
+    CheckTickIndependent({{Direction::EAST, 10'000}, {Direction::NORTH, 25'000}});
+    CheckTickIndependent({{Direction::EAST, 10'000}, {Direction::SOUTH, 25'000}, {Direction::EAST, 50'000}});
+    CheckTickIndependent({{Direction::EAST, 20'000}, {Direction::SOUTH, 10'000}, {Direction::WEST, 50'000},
+                          {Direction::NORTH, 50'000}});
+}
+
+TEST_CASE("Stopped dog keeps its position", "[CalculateMove]") {
+    auto map = MakeCrossroadsMap();
+    const std::vector<Walk> walks{{Direction::EAST, 30'000}, {Direction::EAST, 5'000}};
+    const auto state = RunSession(map, walks, 1'000'000);
+    CHECK(std::abs(state.position.x - (20 + MAX_DELTA)) < TOLERANCE);
+    CHECK(state.speed == Speed{});
+}